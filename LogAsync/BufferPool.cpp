@@ -0,0 +1,79 @@
+#include <iterator>
+
+#include <concurrentqueue.h>
+
+#include "BufferPool.h"
+#include "ConfigurationHandler.h"
+
+namespace
+{
+	// Payload buffers of written records, which producers take a batch at a time.  Never destroyed, as
+	// records can still be recycled after this file's statics are gone.
+	moodycamel::ConcurrentQueue<std::string>& ReturnedBuffers()
+	{
+		static auto* returned = new moodycamel::ConcurrentQueue<std::string>();
+		return *returned;
+	}
+
+	std::vector<std::string>& LocalBuffers()
+	{
+		static thread_local std::vector<std::string> localBuffers;
+		return localBuffers;
+	}
+}
+
+std::string AcquireLogBuffer()
+{
+	auto& localBuffers = LocalBuffers();
+
+	if (localBuffers.empty())
+	{
+		localBuffers.resize(LOG_BUFFER_LOCAL_BATCH);
+		const size_t numTaken = ReturnedBuffers().try_dequeue_bulk(localBuffers.begin(), LOG_BUFFER_LOCAL_BATCH);
+		localBuffers.resize(numTaken);
+	}
+
+	if (localBuffers.empty())
+	{
+		std::string buffer;
+		buffer.reserve(LOG_BUFFER_INITIAL_CAPACITY);
+		return buffer;
+	}
+
+	std::string buffer = std::move(localBuffers.back());
+	localBuffers.pop_back();
+	return buffer;
+}
+
+void ReleaseLogBuffer(std::string&& buffer)
+{
+	const size_t capacity = buffer.capacity();
+	if (capacity < LOG_BUFFER_INITIAL_CAPACITY || capacity > LOG_BUFFER_MAX_POOLED_CAPACITY) { return; }
+
+	auto& localBuffers = LocalBuffers();
+	if (localBuffers.size() >= LOG_BUFFER_LOCAL_BATCH) { return; }
+
+	buffer.clear();
+	localBuffers.emplace_back(std::move(buffer));
+}
+
+void RecycleLogBuffers(std::vector<LogData>& records)
+{
+	auto& returned = ReturnedBuffers();
+	if (returned.size_approx() >= LOG_BUFFER_POOL_LIMIT) { return; }
+
+	static thread_local std::vector<std::string> toReturn;
+	static thread_local moodycamel::ProducerToken token(returned);
+
+	for (auto& l : records)
+	{
+		const size_t capacity = l._logContent.SpillCapacity();
+		if (capacity < LOG_BUFFER_INITIAL_CAPACITY || capacity > LOG_BUFFER_MAX_POOLED_CAPACITY) { continue; }
+
+		toReturn.emplace_back(l._logContent.TakeSpill());
+		toReturn.back().clear();
+	}
+
+	returned.enqueue_bulk(token, std::make_move_iterator(toReturn.begin()), toReturn.size());
+	toReturn.clear();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct LogData;
+
+// ------------------------------------------------------------------------------------
+// Recycling of message buffers.
+//
+// Payloads too large to be stored inline in a LogData (see LogPayload) spill into strings
+// that are filled by the logging threads and freed by the consumer once every log/socket
+// has handled them, which makes malloc move memory between threads on every record.
+// Instead, the consumer hands spilled strings back through a lock free return queue once
+// a batch has been logged, and each logging thread keeps a small cache of them to build
+// its next records in.  Once the pool has warmed up, a logging call doesn't allocate or
+// free anything for its payload.
+//
+// Only buffers between LOG_BUFFER_INITIAL_CAPACITY and LOG_BUFFER_MAX_POOLED_CAPACITY are
+// kept, and at most LOG_BUFFER_POOL_LIMIT of them wait in the return queue, so a burst of
+// huge messages doesn't pin memory.
+// ------------------------------------------------------------------------------------
+
+constexpr size_t LOG_BUFFER_INITIAL_CAPACITY = 256;
+constexpr size_t LOG_BUFFER_MAX_POOLED_CAPACITY = 16384;
+constexpr size_t LOG_BUFFER_POOL_LIMIT = 8192;
+constexpr size_t LOG_BUFFER_LOCAL_BATCH = 32; // Buffers a thread takes from the return queue at once.
+
+// An empty string to build a payload in, reused if possible.
+std::string AcquireLogBuffer();
+
+// Gives a buffer back to this thread's cache once its contents have been copied elsewhere.
+void ReleaseLogBuffer(std::string&& buffer);
+
+// Called by the consumer once every log has handled the records.  Spilled payloads are moved
+// out, so the records shouldn't be used afterwards.
+void RecycleLogBuffers(std::vector<LogData>& records);
@@ -1,86 +1,192 @@
-#pragma once
-
-#include <string>
-#include <cstdint>
-#include <vector>
-#include <unordered_set>
-
-#include "TimeManip.h"
-
-static const std::string DEFAULT_LOGGING_FORMAT = "%t | %S | %T | %m";
-
-struct LogData
-{
-	uint64_t _insertionPoint; // Assumption is that we won't ever log 2^64 logs, and if we do, only a small number
-	                          // being logged will be logged out of order.  This is more accurate (guaranteed
-	                          // in-order if the position is atomic) than using time as a sorting metric.
-
-	system_clock::time_point _timeLogged;  // Wall clock timestamp (NONSTATIC)
-	std::string _codeSrc;                  // Line of code with file name (STATIC)
-	std::unordered_set<std::string> _tags; // List of tags associated with the line (STATIC)
-	std::string _logContent;               // The logged string. (NONSTATIC)
-
-    LogData();
-    LogData(std::string&& src, std::unordered_set<std::string>&& tags, std::string&& content);
-
-    // --------------------------------------------------------------------------------------------
-    // Sort operates on operator<, but sort with the largest element first.  However,
-    // as we're interested in sorting by both smallest time AND insertion point, we'll want to 
-    // invert this - return true only if the other element is larger than this one!
-    // --------------------------------------------------------------------------------------------
-    bool operator<(const LogData& o) const;
-
-};
-
-// --------------------------------------------------------------------------------------------
-// LoggingFormat contains the configuration used to parse the timestamp of the logged message
-// and the format of the logging line.
-// --------------------------------------------------------------------------------------------
-class LoggingFormat
-{
-private:
-    // We'll just collect a sequential list of functions that will be appended to a string in-order
-    // to construct the final logging string.
-
-	
-    std::vector<std::function<std::string(const LogData&)>> _parsingSchema;
-    std::string _dateformat;
-
-    // --------------------------------------------------------------------------------------------
-    // See TimeManip.h [ConstructTimestamp] for more information in the formatting of this string.
-    // --------------------------------------------------------------------------------------------
-    void SetDateFormat(const std::string& s);
-
-    
-public:
-    LoggingFormat();
-
-    // --------------------------------------------------------------------------------------------
-    // _logformat is a string dictating log format.  It uses the following terms:
-    //
-    // - %t:  timestamp of the log message.
-    //
-    // - %s:  source information (file/line) of the logged line.
-    // - %S:  source information (file/line) of the logged line, stripped of any path elements.
-    // 
-    // - %T:  Tags associated with the log data.  WARNING(!!) This assumes that tags given on any
-    //        logging line are not modified dynamically - this is for efficiency and speed in being
-    //        able to look up tags!
-    //
-    // - %m:  message content.
-    //
-    // - %%:  a percent sign.
-    //
-    //  The input will be modified, which is why it's not passed by const ref.
-    // --------------------------------------------------------------------------------------------
-    void SetLogFormat(std::string logformat = DEFAULT_LOGGING_FORMAT, 
-                      std::string dateformat = DEFAULT_TIME);
-
-    // --------------------------------------------------------------------------------------------
-    // Based on the configuration settings of the class, process the logging struct and convert
-    // it into a string that can be logged, sent over a socket, or whatever it's configured to do.
-    // --------------------------------------------------------------------------------------------
-	std::string GetLogStringFrom(const LogData& l) const;
-	void AppendLogToString(const LogData& l, std::string& out) const;
-
-};
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <vector>
+
+#include "TimeManip.h"
+#include "LogClock.h"
+#include "LogTags.h"
+#include "LogArguments.h"
+#include "LogContext.h"
+
+static const std::string DEFAULT_LOGGING_FORMAT = "%t | %S | %T | %m";
+
+// --------------------------------------------------------------------------------------------
+// LogSite describes a single logging line.  Everything about a line is constant, so every
+// LOG_ASYNC macro owns a static LogSite and each LogData logged from it only carries a pointer.
+// This also lets anything caching per-line information (filter results, tag strings) key on
+// the address of the site rather than hashing strings.
+// --------------------------------------------------------------------------------------------
+struct LogSite
+{
+	std::string _source;         // Line of code with file name, as given by AT
+	std::string _strippedSource; // _source without any path elements
+	unsigned _line;              // Line number, or 0 if it couldn't be parsed from the source
+	unsigned _level;             // Most severe logging level in the tags (see LOG_LEVELS_INTEGRAL)
+	TagSet _tags;                // Interned tags associated with the line
+	std::string _tagList;        // Tags joined by ", " for formatting
+
+	LogSite(const char* source, const TagSet& tags);
+};
+
+// --------------------------------------------------------------------------------------------
+// Site used by LogData that wasn't logged from a LOG_ASYNC macro.
+// --------------------------------------------------------------------------------------------
+const LogSite& UnknownLogSite();
+
+// --------------------------------------------------------------------------------------------
+// What LogData::_logContent holds.  Deferred payloads are raw arguments that are only turned
+// into text by the logging thread (see LogArguments.h).
+// --------------------------------------------------------------------------------------------
+enum class PayloadKind : uint8_t
+{
+	TEXT,            // Formatted text.
+	DEFERRED_STREAM, // Arguments streamed into a LoggingStream.
+	DEFERRED_PRINTF, // Arguments to the printf style format string in LogData::_format.
+	FIELDS,          // Typed key/value fields logged with LOG_ASYNC_KV.
+};
+
+// --------------------------------------------------------------------------------------------
+// Storage for a record's payload.  Most messages are short, so anything up to
+// LOG_INLINE_PAYLOAD_SIZE bytes is kept inside the record itself and a LogData is a fixed
+// four cache lines (on 64 bit builds) that queues move around without touching the heap.
+// Larger payloads spill into a string, which comes from (and goes back to) the buffer pool.
+// --------------------------------------------------------------------------------------------
+constexpr size_t LOG_INLINE_PAYLOAD_SIZE = 152;
+
+class LogPayload
+{
+private:
+	size_t _size;
+	char _inline[LOG_INLINE_PAYLOAD_SIZE];
+	std::string _spill; // Only used if _size > LOG_INLINE_PAYLOAD_SIZE
+
+public:
+	LogPayload();
+	LogPayload(const LogPayload& o);
+	LogPayload(LogPayload&& o) noexcept;
+	LogPayload& operator=(const LogPayload& o);
+	LogPayload& operator=(LogPayload&& o) noexcept;
+
+	void Assign(const char* data, const size_t size);
+	void Assign(std::string&& content); // Small contents are copied and the string is reused.
+
+	const char* data() const { return IsSpilled() ? _spill.data() : _inline; }
+	size_t size() const { return _size; }
+	bool empty() const { return _size == 0; }
+	bool IsSpilled() const { return _size > LOG_INLINE_PAYLOAD_SIZE; }
+	std::string str() const { return std::string(data(), _size); }
+
+	// For the buffer pool - takes the spilled string, leaving the payload empty.
+	size_t SpillCapacity() const { return IsSpilled() ? _spill.capacity() : 0; }
+	std::string TakeSpill();
+};
+
+struct LogData
+{
+	uint64_t _insertionPoint; // Assumption is that we won't ever log 2^64 logs, and if we do, only a small number
+	                          // being logged will be logged out of order.  This is more accurate (guaranteed
+	                          // in-order if the position is atomic) than using time as a sorting metric.
+
+	int64_t _clockTicks;                   // Raw reading of the active ClockSource (NONSTATIC)
+	system_clock::time_point _timeLogged;  // Wall clock timestamp, converted from _clockTicks by the logging thread (NONSTATIC)
+	const LogSite* _site;                  // Source, tags and level of the logging line (STATIC)
+	PayloadKind _payloadKind;              // How _logContent is encoded (NONSTATIC)
+	bool _memoryCounted;                   // Counted against the queue's memory limit, if one was set when it was enqueued (NONSTATIC)
+	uint32_t _producer;                    // Which producer's counts it was enqueued under, for flushing (NONSTATIC)
+	const char* _format;                   // Format string for DEFERRED_PRINTF payloads (NONSTATIC)
+	std::shared_ptr<const LogContext> _context; // Scoped context of the logging thread, if any (NONSTATIC)
+	LogPayload _logContent;                // The logged string, or its raw arguments if deferred. (NONSTATIC)
+
+    LogData();
+    LogData(const LogSite& site, std::string&& content, const PayloadKind kind = PayloadKind::TEXT, const char* format = nullptr);
+    LogData(const LogSite& site, const char* content, const size_t size, const PayloadKind kind = PayloadKind::TEXT, const char* format = nullptr);
+
+    // --------------------------------------------------------------------------------------------
+    // The logged message as text, formatting deferred arguments if need be.  Filters looking at
+    // message content should use this rather than _logContent.
+    // --------------------------------------------------------------------------------------------
+    std::string RenderContent() const;
+    void AppendContentTo(std::string& out, const FieldFormat f = FieldFormat::TEXT) const;
+
+    // --------------------------------------------------------------------------------------------
+    // Finds a field of a FIELDS record, so filters can check values without parsing any text.
+    // Returns false if the record has no such field (or isn't a FIELDS record).
+    // --------------------------------------------------------------------------------------------
+    bool FindField(const char* key, FieldValue& value) const;
+
+    // Same as FindField, for the fields of the record's ScopedContext.
+    bool FindContext(const char* key, FieldValue& value) const;
+
+    // --------------------------------------------------------------------------------------------
+    // Sort operates on operator<, but sort with the largest element first.  However,
+    // as we're interested in sorting by both smallest time AND insertion point, we'll want to 
+    // invert this - return true only if the other element is larger than this one!
+    // --------------------------------------------------------------------------------------------
+    bool operator<(const LogData& o) const;
+
+};
+
+// --------------------------------------------------------------------------------------------
+// LoggingFormat contains the configuration used to parse the timestamp of the logged message
+// and the format of the logging line.
+// --------------------------------------------------------------------------------------------
+class LoggingFormat
+{
+private:
+    // We'll just collect a sequential list of functions that will be appended to a string in-order
+    // to construct the final logging string.
+
+	
+    std::vector<std::function<std::string(const LogData&)>> _parsingSchema;
+    std::string _logformat;
+    std::string _dateformat;
+    FieldFormat _fieldFormat;
+
+    // --------------------------------------------------------------------------------------------
+    // See TimeManip.h [ConstructTimestamp] for more information in the formatting of this string.
+    // --------------------------------------------------------------------------------------------
+    void SetDateFormat(const std::string& s);
+
+    
+public:
+    LoggingFormat();
+
+    // --------------------------------------------------------------------------------------------
+    // _logformat is a string dictating log format.  It uses the following terms:
+    //
+    // - %t:  timestamp of the log message.
+    //
+    // - %s:  source information (file/line) of the logged line.
+    // - %S:  source information (file/line) of the logged line, stripped of any path elements.
+    // 
+    // - %T:  Tags associated with the log data.  WARNING(!!) This assumes that tags given on any
+    //        logging line are not modified dynamically - this is for efficiency and speed in being
+    //        able to look up tags!
+    //
+    // - %m:  message content.  Fields logged with LOG_ASYNC_KV are written as set by SetFieldFormat.
+    //
+    // - %C:  fields of the Logging::ScopedContext the line was logged in, written as set by
+    //        SetFieldFormat.  Empty if there isn't one.
+    //
+    // - %%:  a percent sign.
+    //
+    //  The input will be modified, which is why it's not passed by const ref.
+    // --------------------------------------------------------------------------------------------
+    void SetLogFormat(std::string logformat = DEFAULT_LOGGING_FORMAT, 
+                      std::string dateformat = DEFAULT_TIME);
+
+    // --------------------------------------------------------------------------------------------
+    // How %m writes out the fields of records logged with LOG_ASYNC_KV (TEXT by default).
+    // --------------------------------------------------------------------------------------------
+    void SetFieldFormat(const FieldFormat f);
+
+    // --------------------------------------------------------------------------------------------
+    // Based on the configuration settings of the class, process the logging struct and convert
+    // it into a string that can be logged, sent over a socket, or whatever it's configured to do.
+    // --------------------------------------------------------------------------------------------
+	std::string GetLogStringFrom(const LogData& l) const;
+	void AppendLogToString(const LogData& l, std::string& out) const;
+
+};
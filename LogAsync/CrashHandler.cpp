@@ -0,0 +1,296 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "CrashHandler.h"
+#include "LogHandler.h"
+
+namespace
+{
+	// Registered logs.  Slots are only claimed and cleared under crashLogLock; the handler reads
+	// them without it.
+	std::mutex crashLogLock;
+	std::atomic<LogBase*> crashLogs[LOG_CRASH_MAX_LOGS];
+
+	std::atomic<bool> crashHandlerEnabled(false);
+	std::atomic<bool> crashing(false);
+
+#ifndef _MSC_VER
+	std::atomic<int> crashFd(STDERR_FILENO);
+	std::vector<char> alternateStack;
+
+	// What handled each signal before us, for the handler to give the signal back to.
+	struct sigaction previousActions[NSIG];
+	bool hasPreviousAction[NSIG];
+
+	const char* SignalName(const int sig)
+	{
+		switch (sig)
+		{
+			case SIGSEGV: { return "SIGSEGV"; }
+			case SIGABRT: { return "SIGABRT"; }
+			case SIGBUS:  { return "SIGBUS"; }
+			case SIGFPE:  { return "SIGFPE"; }
+			case SIGILL:  { return "SIGILL"; }
+			case SIGTERM: { return "SIGTERM"; }
+			default:      { return "signal"; }
+		}
+	}
+
+	// ---------------------------------------------------------------------------
+	// gmtime isn't async-signal-safe, so the UTC date is worked out by hand
+	// (days to a civil date, as in Howard Hinnant's date algorithms).
+	// ---------------------------------------------------------------------------
+	void AppendUTC(CrashWriter& w, const timespec& ts)
+	{
+		const int64_t secondsOfDay = ts.tv_sec % 86400;
+		const int64_t z = ts.tv_sec / 86400 + 719468;
+		const int64_t era = z / 146097;
+		const int64_t dayOfEra = z - era * 146097;
+		const int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+		const int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+		const int64_t mp = (5 * dayOfYear + 2) / 153;
+		const int64_t day = dayOfYear - (153 * mp + 2) / 5 + 1;
+		const int64_t month = mp < 10 ? mp + 3 : mp - 9;
+		const int64_t year = yearOfEra + era * 400 + (month <= 2 ? 1 : 0);
+
+		w.AppendNumber(year, 4);                   w.Append("-");
+		w.AppendNumber(month, 2);                  w.Append("-");
+		w.AppendNumber(day, 2);                    w.Append(" ");
+		w.AppendNumber(secondsOfDay / 3600, 2);    w.Append(":");
+		w.AppendNumber(secondsOfDay / 60 % 60, 2); w.Append(":");
+		w.AppendNumber(secondsOfDay % 60, 2);      w.Append(".");
+		w.AppendNumber(ts.tv_nsec / 1000, 6);      w.Append(" UTC");
+	}
+
+	// ---------------------------------------------------------------------------
+	// Only the first crashing thread drains anything; a second signal (say the
+	// drain itself faulting) goes straight to the previous handler.
+	// ---------------------------------------------------------------------------
+	void OnCrash(const int sig, siginfo_t*, void*)
+	{
+		if (!crashing.exchange(true))
+		{
+			timespec now = {0, 0};
+			clock_gettime(CLOCK_REALTIME, &now);
+
+			CrashWriter marker(-1);
+			marker.Append("*** LogAsync: process ");
+			marker.AppendNumber(static_cast<uint64_t>(getpid()));
+			marker.Append(" caught ");
+			marker.Append(SignalName(sig));
+			marker.Append(" (");
+			marker.AppendNumber(static_cast<uint64_t>(sig));
+			marker.Append(") at ");
+			AppendUTC(marker, now);
+			marker.Append("; nothing after this was logged ***\n");
+
+			for (auto& slot : crashLogs)
+			{
+				if (LogBase* l = slot.load(std::memory_order_acquire)) { l->WriteOnCrash(marker.Data(), marker.Size()); }
+			}
+
+			CrashWriter out(crashFd.load(std::memory_order_acquire));
+			WriteQueuedRecordsOnCrash(out);
+			out.Append(marker.Data(), marker.Size());
+		}
+
+		// Hand the signal back; it's blocked until we return, and then acted on as it would have been.
+		if (sig < NSIG && hasPreviousAction[sig]) { sigaction(sig, &previousActions[sig], nullptr); }
+		else { signal(sig, SIG_DFL); }
+		raise(sig);
+	}
+#endif
+}
+
+// ---------------------------------------------------------------------------------
+// Implementation for CrashWriter
+// ---------------------------------------------------------------------------------
+void CrashWrite(const int fd, const char* data, size_t size)
+{
+#ifndef _MSC_VER
+	while (fd >= 0 && size > 0)
+	{
+		const ssize_t written = ::write(fd, data, size);
+		if (written < 0 && errno == EINTR) { continue; }
+		if (written <= 0) { return; }
+
+		data += written;
+		size -= static_cast<size_t>(written);
+	}
+#endif
+}
+
+void CrashWriter::Append(const char* data, size_t size)
+{
+	while (size > 0)
+	{
+		if (_used == LOG_CRASH_BUFFER_SIZE)
+		{
+			// A collecting writer keeps what fits.
+			if (_fd < 0) { return; }
+			Flush();
+		}
+
+		const size_t n = std::min(size, LOG_CRASH_BUFFER_SIZE - _used);
+		std::memcpy(_buffer + _used, data, n);
+		_used += n;
+		data += n;
+		size -= n;
+	}
+}
+
+void CrashWriter::Append(const char* s)
+{
+	Append(s, std::strlen(s));
+}
+
+void CrashWriter::AppendNumber(uint64_t n, const unsigned minDigits)
+{
+	char digits[20];
+	unsigned count = 0;
+	do
+	{
+		digits[count++] = static_cast<char>('0' + n % 10);
+		n /= 10;
+	} while (n != 0 && count < sizeof(digits));
+
+	for (unsigned i = count; i < minDigits; ++i) { Append("0", 1); }
+	while (count > 0) { Append(&digits[--count], 1); }
+}
+
+void CrashWriter::Flush()
+{
+	if (_fd < 0) { return; }
+	CrashWrite(_fd, _buffer, _used);
+	_used = 0;
+}
+
+// ---------------------------------------------------------------------------------
+// Registration of logs
+// ---------------------------------------------------------------------------------
+void RegisterCrashLog(LogBase* l)
+{
+	std::lock_guard<std::mutex> lock(crashLogLock);
+	for (auto& slot : crashLogs)
+	{
+		LogBase* empty = nullptr;
+		if (slot.compare_exchange_strong(empty, l)) { return; }
+	}
+}
+
+void UnregisterCrashLog(LogBase* l)
+{
+	std::lock_guard<std::mutex> lock(crashLogLock);
+	for (auto& slot : crashLogs)
+	{
+		LogBase* registered = l;
+		if (slot.compare_exchange_strong(registered, nullptr)) { return; }
+	}
+}
+
+bool CrashHandlerEnabled()
+{
+	return crashHandlerEnabled.load(std::memory_order_acquire);
+}
+
+void AppendRecordOnCrash(CrashWriter& w, const LogData& l)
+{
+	if (l._site != nullptr)
+	{
+		w.Append("[");
+		w.Append(l._site->_tagList.data(), l._site->_tagList.size());
+		w.Append("] ");
+		w.Append(l._site->_strippedSource.data(), l._site->_strippedSource.size());
+		w.Append(": ");
+	}
+
+	switch (l._payloadKind)
+	{
+		case PayloadKind::TEXT:            { w.Append(l._logContent.data(), l._logContent.size()); break; }
+		case PayloadKind::DEFERRED_PRINTF: { w.Append("(unformatted) "); w.Append(l._format != nullptr ? l._format : ""); break; }
+		case PayloadKind::DEFERRED_STREAM:
+		case PayloadKind::FIELDS:
+		default:                           { w.Append("(unformatted arguments)"); break; }
+	}
+	w.Append("\n");
+}
+
+namespace Logging
+{
+	bool EnableCrashHandler(const std::string& crashFile, const std::vector<int>& signals)
+	{
+#ifdef _MSC_VER
+		std::cerr << "WARNING - The crash handler needs POSIX signals, which this platform doesn't have." << std::endl;
+		return false;
+#else
+		std::lock_guard<std::mutex> lock(crashLogLock);
+
+		if (!crashFile.empty())
+		{
+			const int fd = ::open(crashFile.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+			if (fd < 0)
+			{
+				std::cerr << "ERROR - Unable to open " << crashFile << " for the crash handler!" << std::endl;
+				return false;
+			}
+
+			const int previous = crashFd.exchange(fd);
+			if (previous != STDERR_FILENO) { ::close(previous); }
+		}
+
+		if (alternateStack.empty())
+		{
+			alternateStack.resize(LOG_CRASH_STACK_SIZE);
+
+			stack_t stack;
+			stack.ss_sp = alternateStack.data();
+			stack.ss_size = alternateStack.size();
+			stack.ss_flags = 0;
+			if (sigaltstack(&stack, nullptr) != 0) { std::cerr << "WARNING - Unable to set up a stack for the crash handler; stack overflows won't be handled." << std::endl; }
+		}
+
+		// Logs opened before now need their descriptors; logs opened later get them in OpenLog.
+		crashHandlerEnabled = true;
+		for (auto& slot : crashLogs)
+		{
+			if (LogBase* l = slot.load()) { l->PrepareForCrash(); }
+		}
+
+		for (const int sig : signals)
+		{
+			struct sigaction action;
+			std::memset(&action, 0, sizeof(action));
+			action.sa_sigaction = OnCrash;
+			action.sa_flags = SA_SIGINFO | SA_ONSTACK;
+			sigemptyset(&action.sa_mask);
+
+			struct sigaction previous;
+			if (sigaction(sig, &action, &previous) != 0)
+			{
+				std::cerr << "WARNING - Unable to handle signal " << sig << " for the crash handler." << std::endl;
+				continue;
+			}
+
+			// Enabling twice mustn't make the handler its own previous handler.
+			const bool wasOurs = (previous.sa_flags & SA_SIGINFO) && previous.sa_sigaction == OnCrash;
+			if (sig < NSIG && !wasOurs)
+			{
+				previousActions[sig] = previous;
+				hasPreviousAction[sig] = true;
+			}
+		}
+
+		return true;
+#endif
+	}
+}
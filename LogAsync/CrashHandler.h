@@ -0,0 +1,93 @@
+#pragma once
+
+#include <csignal>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class LogBase;
+struct LogData;
+
+constexpr size_t LOG_CRASH_MAX_LOGS = 64;          // Logs the crash handler can drain; any past this are left out.
+constexpr size_t LOG_CRASH_BUFFER_SIZE = 4096;     // Bytes a CrashWriter collects before it writes them.
+constexpr size_t LOG_CRASH_STACK_SIZE = 64 * 1024; // Alternate signal stack, so a stack overflow can still be handled.
+
+#ifdef SIGBUS
+#define LOG_CRASH_SIGNALS {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL}
+#else
+#define LOG_CRASH_SIGNALS {SIGSEGV, SIGABRT, SIGFPE, SIGILL}
+#endif
+
+// ------------------------------------------------------------------------------------
+// Everything the crash handler does has to be async-signal-safe: no allocation, no locks,
+// no stdio.  A CrashWriter collects text in a fixed buffer and hands it to raw write()s.
+// ------------------------------------------------------------------------------------
+void CrashWrite(const int fd, const char* data, const size_t size);
+
+class CrashWriter
+{
+private:
+	int _fd;
+	size_t _used;
+	char _buffer[LOG_CRASH_BUFFER_SIZE];
+
+public:
+	// A writer with a negative fd only collects text, for Data() to hand out.
+	explicit CrashWriter(const int fd) : _fd(fd), _used(0) {}
+	~CrashWriter() { Flush(); }
+
+	CrashWriter(const CrashWriter&) = delete;
+	CrashWriter& operator=(const CrashWriter&) = delete;
+
+	void Append(const char* data, size_t size);
+	void Append(const char* s);
+	void AppendNumber(uint64_t n, const unsigned minDigits = 1);
+	void Flush();
+
+	const char* Data() const { return _buffer; }
+	size_t Size() const { return _used; }
+};
+
+// --------------------------------------------------------------------------------------------
+// For the library: RotatedLogs register so the crash handler can write out what they haven't
+// written yet (see LogBase::WriteOnCrash), and open a descriptor for it while the crash handler
+// is enabled.
+// --------------------------------------------------------------------------------------------
+void RegisterCrashLog(LogBase* l);
+void UnregisterCrashLog(LogBase* l);
+bool CrashHandlerEnabled();
+
+// One line for a record that never got to a log.  Only text payloads can be written as they
+// are; the format string stands in for deferred printf arguments.
+void AppendRecordOnCrash(CrashWriter& w, const LogData& l);
+
+// Defined with the queue, in LogAsync.cpp.
+void WriteQueuedRecordsOnCrash(CrashWriter& w);
+
+namespace Logging
+{
+	// --------------------------------------------------------------------------------------------
+	// Opt-in handling of crashes.  When one of the signals arrives, before the process goes down:
+	//
+	// - Every RotatedLog appends what it had formatted but not yet written, followed by a crash
+	//   marker line naming the signal.  Logs write out each batch as soon as they've formatted
+	//   it, so there's usually nothing pending and typically only the marker is written.
+	// - Records still waiting in per-thread rings (PER_THREAD_RINGS) are written, without a log's
+	//   formatting or filters, to crashFile (stderr if it's empty).  With SHARED_QUEUE nothing
+	//   that's queued is recovered.
+	// - Records in the shared queue, and batches that a sink thread hasn't got to (with either
+	//   engine), can't be reached without taking a lock, so they're lost.  crashFile gets a line
+	//   counting them.
+	//
+	// The signal is then handed back to whatever handled it before (the default action, unless
+	// something else installed a handler), so core dumps and exit codes are as they were.
+	//
+	// The handler only uses descriptors opened beforehand and raw write()s.  It reads buffers that
+	// other threads may be in the middle of changing, so the output is best effort: a line can be
+	// cut short or, rarely, repeated.  A stack overflow is only handled on the thread that enabled
+	// the handler, which is the only one given an alternate signal stack.  Returns false if the
+	// crash file can't be opened, or on platforms without POSIX signals.
+	// --------------------------------------------------------------------------------------------
+	bool EnableCrashHandler(const std::string& crashFile = "", const std::vector<int>& signals = LOG_CRASH_SIGNALS);
+}
@@ -0,0 +1,464 @@
+#include <cmath>
+
+#include <fmt/printf.h>
+
+#include "LogArguments.h"
+
+namespace
+{
+	// ------------------------------------------------------------------------------------
+	// Walks an encoded argument buffer one argument at a time.
+	//
+	// Buffers can come from another process (see ImportFields), so nothing is read past the
+	// end: an argument that's cut short reads as zero (or an empty string), and marks the
+	// buffer as truncated.
+	// ------------------------------------------------------------------------------------
+	class ArgumentReader
+	{
+	private:
+		const char* _pos;
+		const char* _end;
+		bool _truncated;
+
+		bool Has(const size_t size)
+		{
+			if (static_cast<size_t>(_end - _pos) >= size) { return true; }
+
+			_pos = _end;
+			_truncated = true;
+			return false;
+		}
+
+		template <class T> T Read()
+		{
+			T value{};
+			if (!Has(sizeof(T))) { return value; }
+
+			std::memcpy(&value, _pos, sizeof(T));
+			_pos += sizeof(T);
+			return value;
+		}
+
+	public:
+		ArgumentReader(const char* encoded, const size_t encodedSize) : _pos(encoded), _end(encoded + encodedSize), _truncated(false) {}
+
+		bool Empty() const { return _pos >= _end; }
+		bool Truncated() const { return _truncated; }
+		const char* Position() const { return _pos; }
+
+		// Structured fields put the key's pointer in front of each value.
+		const char* NextKey() { return Read<const char*>(); }
+
+		// --------------------------------------------------------------------------------
+		// Decode the next argument and hand it to f as its original C++ type.  Strings are
+		// handed over as a (pointer, length) pair through f.String.
+		// --------------------------------------------------------------------------------
+		template <class F> void Next(F& f)
+		{
+			if (!Has(1)) { return; }
+
+			const ArgumentType type = static_cast<ArgumentType>(*_pos++);
+			switch (type)
+			{
+				case ArgumentType::BOOL:    { f(Read<bool>()); break; }
+				case ArgumentType::CHAR:    { f(Read<char>()); break; }
+				case ArgumentType::INT16:   { f(Read<int16_t>()); break; }
+				case ArgumentType::UINT16:  { f(Read<uint16_t>()); break; }
+				case ArgumentType::INT32:   { f(Read<int32_t>()); break; }
+				case ArgumentType::UINT32:  { f(Read<uint32_t>()); break; }
+				case ArgumentType::INT64:   { f(Read<int64_t>()); break; }
+				case ArgumentType::UINT64:  { f(Read<uint64_t>()); break; }
+				case ArgumentType::FLOAT:   { f(Read<float>()); break; }
+				case ArgumentType::DOUBLE:  { f(Read<double>()); break; }
+				case ArgumentType::POINTER: { f(Read<const void*>()); break; }
+				case ArgumentType::STRING:
+				default:
+				{
+					const uint32_t len = Read<uint32_t>();
+					if (!Has(len))
+					{
+						f.String(_pos, 0);
+						break;
+					}
+
+					f.String(_pos, len);
+					_pos += len;
+					break;
+				}
+			}
+		}
+	};
+
+	struct StreamRenderer
+	{
+		fmt::MemoryWriter& w;
+		std::string& out;
+
+		template <class T> void operator()(const T& v) { w << v; }
+
+		// Writers don't stream pointers, so match what fmt would print for them.
+		void operator()(const void* v)
+		{
+			const std::string s = fmt::format("{}", v);
+			String(s.data(), static_cast<uint32_t>(s.size()));
+		}
+
+		// Strings don't need formatting; just move whatever's been formatted so far out
+		// of the writer so the ordering is kept, and copy the string straight across.
+		void String(const char* s, const uint32_t len)
+		{
+			out.append(w.data(), w.size());
+			w.clear();
+			out.append(s, len);
+		}
+	};
+
+	struct PrintfRenderer
+	{
+		const std::string& spec;
+		std::string& out;
+
+		template <class T> void operator()(const T& v) { out += fmt::sprintf(spec, v); }
+		void String(const char* s, const uint32_t len) { out += fmt::sprintf(spec, std::string(s, len)); }
+	};
+
+	// Pulls an integer out for '*' width/precision specifiers.
+	struct IntegerExtractor
+	{
+		int64_t value = 0;
+
+		template <class T> void operator()(const T& v) { value = static_cast<int64_t>(v); }
+		void operator()(const void*) {}
+		void String(const char*, const uint32_t) {}
+	};
+
+	// Steps over an argument without decoding it.
+	struct ArgumentSkipper
+	{
+		template <class T> void operator()(const T&) {}
+		void String(const char*, const uint32_t) {}
+	};
+
+	struct StringExtractor
+	{
+		const char* text = nullptr;
+		uint32_t length = 0;
+
+		template <class T> void operator()(const T&) {}
+		void String(const char* s, const uint32_t len) { text = s; length = len; }
+	};
+
+	struct FieldDecoder
+	{
+		FieldValue& v;
+
+		void operator()(const bool b)     { v._type = ArgumentType::BOOL;   v._boolean = b; }
+		void operator()(const char c)     { v._type = ArgumentType::INT64;  v._signed = c; }
+		void operator()(const int16_t i)  { v._type = ArgumentType::INT64;  v._signed = i; }
+		void operator()(const uint16_t u) { v._type = ArgumentType::UINT64; v._unsigned = u; }
+		void operator()(const int32_t i)  { v._type = ArgumentType::INT64;  v._signed = i; }
+		void operator()(const uint32_t u) { v._type = ArgumentType::UINT64; v._unsigned = u; }
+		void operator()(const int64_t i)  { v._type = ArgumentType::INT64;  v._signed = i; }
+		void operator()(const uint64_t u) { v._type = ArgumentType::UINT64; v._unsigned = u; }
+		void operator()(const float f)    { v._type = ArgumentType::DOUBLE; v._real = f; }
+		void operator()(const double d)   { v._type = ArgumentType::DOUBLE; v._real = d; }
+		void operator()(const void* p)    { v._type = ArgumentType::UINT64; v._unsigned = reinterpret_cast<uintptr_t>(p); }
+
+		void String(const char* s, const uint32_t len)
+		{
+			v._type = ArgumentType::STRING;
+			v._text = s;
+			v._textLength = len;
+		}
+	};
+
+	void AppendJSONString(const char* s, const uint32_t len, std::string& out)
+	{
+		out += '"';
+		for (uint32_t i = 0; i < len; ++i)
+		{
+			const char c = s[i];
+			switch (c)
+			{
+				case '"':  { out += "\\\""; break; }
+				case '\\': { out += "\\\\"; break; }
+				case '\n': { out += "\\n"; break; }
+				case '\r': { out += "\\r"; break; }
+				case '\t': { out += "\\t"; break; }
+				default:
+				{
+					if (static_cast<unsigned char>(c) < 0x20) { out += fmt::format("\\u{:04x}", static_cast<unsigned>(c)); }
+					else { out += c; }
+					break;
+				}
+			}
+		}
+		out += '"';
+	}
+
+	void AppendLogfmtString(const char* s, const uint32_t len, std::string& out)
+	{
+		bool needsQuotes = (len == 0);
+		for (uint32_t i = 0; i < len && !needsQuotes; ++i)
+		{
+			needsQuotes = s[i] == ' ' || s[i] == '=' || s[i] == '"' || static_cast<unsigned char>(s[i]) < 0x20;
+		}
+
+		if (needsQuotes) { AppendJSONString(s, len, out); }
+		else { out.append(s, len); }
+	}
+
+	void AppendFieldValue(const FieldValue& v, const FieldFormat f, std::string& out)
+	{
+		if (v._type == ArgumentType::STRING)
+		{
+			if (f == FieldFormat::JSON)        { AppendJSONString(v._text, v._textLength, out); }
+			else if (f == FieldFormat::LOGFMT) { AppendLogfmtString(v._text, v._textLength, out); }
+			else                               { out.append(v._text, v._textLength); }
+		}
+		else if (v._type == ArgumentType::DOUBLE && f == FieldFormat::JSON && !std::isfinite(v._real))
+		{
+			out += "null";
+		}
+		else { out += v.Text(); }
+	}
+
+	inline bool IsPrintfFlag(const char c)     { return c == '-' || c == '+' || c == ' ' || c == '#' || c == '0'; }
+	inline bool IsPrintfLength(const char c)   { return c == 'h' || c == 'l' || c == 'L' || c == 'q' || c == 'j' || c == 'z' || c == 't'; }
+	inline bool IsDigit(const char c)          { return c >= '0' && c <= '9'; }
+}
+
+void RenderStreamArguments(const char* encoded, const size_t encodedSize, std::string& out)
+{
+	fmt::MemoryWriter w;
+	StreamRenderer renderer{w, out};
+
+	ArgumentReader reader(encoded, encodedSize);
+	while (!reader.Empty()) { reader.Next(renderer); }
+
+	out.append(w.data(), w.size());
+}
+
+void RenderPrintfArguments(const char* format, const char* encoded, const size_t encodedSize, std::string& out)
+{
+	ArgumentReader reader(encoded, encodedSize);
+
+	const char* pos = format;
+	while (*pos != '\0')
+	{
+		if (*pos != '%')
+		{
+			out += *pos++;
+			continue;
+		}
+
+		if (pos[1] == '%')
+		{
+			out += '%';
+			pos += 2;
+			continue;
+		}
+
+		// Collect a single conversion specification: %[flags][width][.precision][length]conversion
+		// Any '*' is replaced by the integer argument it refers to.
+		std::string spec = "%";
+		++pos;
+
+		while (IsPrintfFlag(*pos)) { spec += *pos++; }
+
+		bool missingArgument = false;
+		for (int field = 0; field < 2; ++field)
+		{
+			if (field == 1)
+			{
+				if (*pos != '.') { break; }
+				spec += *pos++;
+			}
+
+			if (*pos == '*')
+			{
+				++pos;
+				if (reader.Empty()) { missingArgument = true; break; }
+
+				IntegerExtractor extractor;
+				reader.Next(extractor);
+				spec += fmt::FormatInt(extractor.value).str();
+			}
+			else
+			{
+				while (IsDigit(*pos)) { spec += *pos++; }
+			}
+		}
+
+		while (IsPrintfLength(*pos)) { spec += *pos++; }
+		if (*pos == '\0') { break; }
+		spec += *pos++;
+
+		if (missingArgument || reader.Empty())
+		{
+			out += "[missing argument for " + spec + "]";
+			continue;
+		}
+
+		try
+		{
+			PrintfRenderer renderer{spec, out};
+			reader.Next(renderer);
+		}
+		catch (const std::exception& e)
+		{
+			out += "[" + spec + ": " + e.what() + "]";
+		}
+	}
+}
+
+FieldValue::FieldValue() :
+	_type(ArgumentType::STRING),
+	_boolean(false),
+	_signed(0),
+	_unsigned(0),
+	_real(0.0),
+	_text(""),
+	_textLength(0)
+{}
+
+bool FieldValue::IsNumber() const
+{
+	return _type == ArgumentType::INT64 || _type == ArgumentType::UINT64 || _type == ArgumentType::DOUBLE;
+}
+
+double FieldValue::AsDouble() const
+{
+	switch (_type)
+	{
+		case ArgumentType::BOOL:   { return _boolean ? 1.0 : 0.0; }
+		case ArgumentType::INT64:  { return static_cast<double>(_signed); }
+		case ArgumentType::UINT64: { return static_cast<double>(_unsigned); }
+		case ArgumentType::DOUBLE: { return _real; }
+		default:                   { return 0.0; }
+	}
+}
+
+std::string FieldValue::Text() const
+{
+	switch (_type)
+	{
+		case ArgumentType::BOOL:   { return _boolean ? "true" : "false"; }
+		case ArgumentType::INT64:  { return fmt::FormatInt(_signed).str(); }
+		case ArgumentType::UINT64: { return fmt::FormatInt(_unsigned).str(); }
+		case ArgumentType::DOUBLE:
+		{
+			fmt::MemoryWriter w;
+			w << _real;
+			return w.str();
+		}
+		default:                   { return std::string(_text, _textLength); }
+	}
+}
+
+void RenderFields(const char* encoded, const size_t encodedSize, const FieldFormat f, std::string& out)
+{
+	ArgumentReader reader(encoded, encodedSize);
+
+	if (f == FieldFormat::JSON) { out += '{'; }
+	for (bool first = true; !reader.Empty(); first = false)
+	{
+		const char* key = reader.NextKey();
+
+		FieldValue value;
+		FieldDecoder decoder{value};
+		reader.Next(decoder);
+		if (reader.Truncated()) { break; }
+
+		switch (f)
+		{
+			case FieldFormat::JSON:
+			{
+				if (!first) { out += ','; }
+				AppendJSONString(key, static_cast<uint32_t>(std::strlen(key)), out);
+				out += ':';
+				break;
+			}
+			case FieldFormat::LOGFMT:
+			{
+				if (!first) { out += ' '; }
+				out += key;
+				out += '=';
+				break;
+			}
+			case FieldFormat::TEXT:
+			default:
+			{
+				if (!first) { out += ", "; }
+				out += key;
+				out += ": ";
+				break;
+			}
+		}
+		AppendFieldValue(value, f, out);
+	}
+	if (f == FieldFormat::JSON) { out += '}'; }
+}
+
+bool FindEncodedField(const char* encoded, const size_t encodedSize, const char* key, FieldValue& value)
+{
+	ArgumentReader reader(encoded, encodedSize);
+	while (!reader.Empty())
+	{
+		const char* fieldKey = reader.NextKey();
+		FieldDecoder decoder{value};
+		reader.Next(decoder);
+		if (reader.Truncated()) { break; }
+
+		if (fieldKey == key || std::strcmp(fieldKey, key) == 0) { return true; }
+	}
+	return false;
+}
+
+void ExportFields(const char* encoded, const size_t encodedSize, std::string& out)
+{
+	ArgumentReader reader(encoded, encodedSize);
+	ArgumentSkipper skipper;
+	while (!reader.Empty())
+	{
+		const char* key = reader.NextKey();
+		const char* value = reader.Position();
+		reader.Next(skipper);
+		if (reader.Truncated()) { break; }
+
+		AppendStringArgument(out, key, std::strlen(key));
+		out.append(value, reader.Position() - value);
+	}
+}
+
+bool ImportFields(const char* exported, const size_t exportedSize, const std::function<const char*(const char*, size_t)>& internKey, std::string& out)
+{
+	const size_t outSize = out.size();
+	ArgumentReader reader(exported, exportedSize);
+	ArgumentSkipper skipper;
+	while (!reader.Empty())
+	{
+		StringExtractor key;
+		reader.Next(key);
+		if (reader.Truncated() || key.text == nullptr)
+		{
+			out.resize(outSize);
+			return false;
+		}
+
+		const char* interned = internKey(key.text, key.length);
+		char raw[sizeof(const char*)];
+		std::memcpy(raw, &interned, sizeof(const char*));
+		out.append(raw, sizeof(const char*));
+
+		const char* value = reader.Position();
+		reader.Next(skipper);
+		if (reader.Truncated())
+		{
+			out.resize(outSize);
+			return false;
+		}
+		out.append(value, reader.Position() - value);
+	}
+	return true;
+}
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <type_traits>
+
+#include <fmt/format.h>
+#include <fmt/ostream.h>
+
+// ------------------------------------------------------------------------------------
+// Deferred formatting support.
+//
+// Rather than converting every streamed/printf argument into text on the calling thread,
+// arguments can be captured as raw bytes (a type byte followed by the value) and turned
+// into text later by the logging thread.  Formatting them later goes through the same
+// fmt calls that would have been made on the calling thread, so the output is the same.
+//
+// Types without a raw encoding (user types with an operator<<, long doubles, etc) are
+// still formatted on the calling thread and captured as a string.
+// ------------------------------------------------------------------------------------
+
+enum class ArgumentType : uint8_t
+{
+	BOOL,
+	CHAR,
+	INT64,
+	UINT64,
+	FLOAT,
+	DOUBLE,
+	POINTER,
+	STRING,  // uint32_t length, followed by the characters.
+	INT16,
+	UINT16,
+	INT32,
+	UINT32,
+};
+
+// ------------------------------------------------------------------------------------
+// Raw encoding helpers.
+// ------------------------------------------------------------------------------------
+template <class T>
+inline void AppendRawArgument(std::string& out, const ArgumentType type, const T value)
+{
+	char raw[sizeof(T)];
+	std::memcpy(raw, &value, sizeof(T));
+	out += static_cast<char>(type);
+	out.append(raw, sizeof(T));
+}
+
+inline void AppendStringArgument(std::string& out, const char* s, const size_t len)
+{
+	const uint32_t len32 = static_cast<uint32_t>(len);
+	char raw[sizeof(uint32_t)];
+	std::memcpy(raw, &len32, sizeof(uint32_t));
+	out += static_cast<char>(ArgumentType::STRING);
+	out.append(raw, sizeof(uint32_t));
+	out.append(s, len32);
+}
+
+// ------------------------------------------------------------------------------------
+// Integers keep their own width, so that conversions that depend on it (%x or %u of a
+// negative int, say) print the same as they would have on the calling thread.
+// ------------------------------------------------------------------------------------
+template <bool Signed, size_t Size> struct IntegerEncoding;
+template <> struct IntegerEncoding<true, 2>  { typedef int16_t Type;  static constexpr ArgumentType type = ArgumentType::INT16; };
+template <> struct IntegerEncoding<false, 2> { typedef uint16_t Type; static constexpr ArgumentType type = ArgumentType::UINT16; };
+template <> struct IntegerEncoding<true, 4>  { typedef int32_t Type;  static constexpr ArgumentType type = ArgumentType::INT32; };
+template <> struct IntegerEncoding<false, 4> { typedef uint32_t Type; static constexpr ArgumentType type = ArgumentType::UINT32; };
+template <> struct IntegerEncoding<true, 8>  { typedef int64_t Type;  static constexpr ArgumentType type = ArgumentType::INT64; };
+template <> struct IntegerEncoding<false, 8> { typedef uint64_t Type; static constexpr ArgumentType type = ArgumentType::UINT64; };
+
+template <class T>
+inline void AppendIntegerArgument(std::string& out, const T v)
+{
+	typedef IntegerEncoding<std::is_signed<T>::value, sizeof(T)> Encoding;
+	AppendRawArgument<typename Encoding::Type>(out, Encoding::type, v);
+}
+
+// ------------------------------------------------------------------------------------
+// Figure out how an argument type gets captured.
+// ------------------------------------------------------------------------------------
+enum class ArgumentCategory { BOOL, CHAR, SIGNED, UNSIGNED, FLOAT, DOUBLE, CSTRING, STRING, POINTER, FORMATTED };
+
+template <class T>
+struct ArgumentCategoryOf
+{
+	typedef typename std::decay<T>::type Decayed;
+
+	static constexpr ArgumentCategory value =
+		std::is_same<Decayed, bool>::value                                    ? ArgumentCategory::BOOL :
+		std::is_same<Decayed, char>::value                                    ? ArgumentCategory::CHAR :
+		std::is_same<Decayed, signed char>::value ||
+		std::is_same<Decayed, unsigned char>::value                           ? ArgumentCategory::FORMATTED :
+		std::is_integral<Decayed>::value && std::is_signed<Decayed>::value    ? ArgumentCategory::SIGNED :
+		std::is_integral<Decayed>::value                                      ? ArgumentCategory::UNSIGNED :
+		std::is_same<Decayed, float>::value                                   ? ArgumentCategory::FLOAT :
+		std::is_same<Decayed, double>::value                                  ? ArgumentCategory::DOUBLE :
+		std::is_same<Decayed, char*>::value ||
+		std::is_same<Decayed, const char*>::value                             ? ArgumentCategory::CSTRING :
+		std::is_same<Decayed, std::string>::value                             ? ArgumentCategory::STRING :
+		std::is_pointer<Decayed>::value &&
+		!std::is_function<typename std::remove_pointer<Decayed>::type>::value ? ArgumentCategory::POINTER :
+		                                                                        ArgumentCategory::FORMATTED;
+};
+
+template <ArgumentCategory C> using ArgumentTag = std::integral_constant<ArgumentCategory, C>;
+
+template <class T> inline void AppendArgument(std::string& out, const T& v, ArgumentTag<ArgumentCategory::BOOL>)     { AppendRawArgument<bool>(out, ArgumentType::BOOL, v); }
+template <class T> inline void AppendArgument(std::string& out, const T& v, ArgumentTag<ArgumentCategory::CHAR>)     { AppendRawArgument<char>(out, ArgumentType::CHAR, v); }
+template <class T> inline void AppendArgument(std::string& out, const T& v, ArgumentTag<ArgumentCategory::SIGNED>)   { AppendIntegerArgument(out, v); }
+template <class T> inline void AppendArgument(std::string& out, const T& v, ArgumentTag<ArgumentCategory::UNSIGNED>) { AppendIntegerArgument(out, v); }
+template <class T> inline void AppendArgument(std::string& out, const T& v, ArgumentTag<ArgumentCategory::FLOAT>)    { AppendRawArgument<float>(out, ArgumentType::FLOAT, v); }
+template <class T> inline void AppendArgument(std::string& out, const T& v, ArgumentTag<ArgumentCategory::DOUBLE>)   { AppendRawArgument<double>(out, ArgumentType::DOUBLE, v); }
+template <class T> inline void AppendArgument(std::string& out, const T& v, ArgumentTag<ArgumentCategory::POINTER>)  { AppendRawArgument<const void*>(out, ArgumentType::POINTER, v); }
+template <class T> inline void AppendArgument(std::string& out, const T& v, ArgumentTag<ArgumentCategory::STRING>)   { AppendStringArgument(out, v.data(), v.size()); }
+
+template <class T> inline void AppendArgument(std::string& out, const T& v, ArgumentTag<ArgumentCategory::CSTRING>)
+{
+	const char* s = v;
+	if (s == nullptr) { s = "(null)"; }
+	AppendStringArgument(out, s, std::strlen(s));
+}
+
+template <class T> inline void AppendArgument(std::string& out, const T& v, ArgumentTag<ArgumentCategory::FORMATTED>)
+{
+	fmt::MemoryWriter w;
+	w << v;
+	AppendStringArgument(out, w.data(), w.size());
+}
+
+// ------------------------------------------------------------------------------------
+// Capture a single argument, or a list of printf arguments, into an encoded buffer.
+// ------------------------------------------------------------------------------------
+template <class T>
+inline void AppendArgument(std::string& out, const T& v)
+{
+	AppendArgument(out, v, ArgumentTag<ArgumentCategoryOf<T>::value>());
+}
+
+inline void AppendArguments(std::string&) {}
+
+template <class T, class ...Args>
+inline void AppendArguments(std::string& out, const T& v, const Args& ...args)
+{
+	AppendArgument(out, v);
+	AppendArguments(out, args...);
+}
+
+// ------------------------------------------------------------------------------------
+// Structured fields (LOG_ASYNC_KV).
+//
+// Each field is the key's pointer followed by its value, encoded as above.  Values are
+// kept as a BOOL, an integer, a DOUBLE or a STRING, and integers of every width are read
+// back as INT64 or UINT64; anything else is formatted on the calling thread and kept as a
+// STRING.  Keys are referenced rather than copied, so they must be string literals.
+// ------------------------------------------------------------------------------------
+template <class T>
+struct FieldCategoryOf
+{
+	typedef typename std::decay<T>::type Decayed;
+
+	static constexpr ArgumentCategory value =
+		std::is_same<Decayed, bool>::value                                 ? ArgumentCategory::BOOL :
+		std::is_same<Decayed, char>::value ||
+		std::is_same<Decayed, signed char>::value ||
+		std::is_same<Decayed, unsigned char>::value                        ? ArgumentCategory::FORMATTED :
+		std::is_integral<Decayed>::value && std::is_signed<Decayed>::value ? ArgumentCategory::SIGNED :
+		std::is_integral<Decayed>::value                                   ? ArgumentCategory::UNSIGNED :
+		std::is_same<Decayed, float>::value ||
+		std::is_same<Decayed, double>::value                               ? ArgumentCategory::DOUBLE :
+		std::is_same<Decayed, char*>::value ||
+		std::is_same<Decayed, const char*>::value                          ? ArgumentCategory::CSTRING :
+		std::is_same<Decayed, std::string>::value                          ? ArgumentCategory::STRING :
+		                                                                     ArgumentCategory::FORMATTED;
+};
+
+template <class T>
+inline void AppendField(std::string& out, const char* key, const T& v)
+{
+	char raw[sizeof(const char*)];
+	std::memcpy(raw, &key, sizeof(const char*));
+	out.append(raw, sizeof(const char*));
+	AppendArgument(out, v, ArgumentTag<FieldCategoryOf<T>::value>());
+}
+
+// How fields are written out by LoggingFormat.
+enum class FieldFormat : uint8_t
+{
+	TEXT,   // key: value, key: value
+	LOGFMT, // key=value key="quoted value"
+	JSON,   // {"key":value,"key":"value"}
+};
+
+// ------------------------------------------------------------------------------------
+// A decoded field value.  Strings point into the record they came from, so a FieldValue
+// shouldn't outlive the record.
+// ------------------------------------------------------------------------------------
+struct FieldValue
+{
+	ArgumentType _type;
+	bool _boolean;
+	int64_t _signed;
+	uint64_t _unsigned;
+	double _real;
+	const char* _text;
+	uint32_t _textLength;
+
+	FieldValue();
+
+	bool IsNumber() const;
+	double AsDouble() const;  // Numbers (and bools, as 0/1) as a double, or 0 for strings.
+	std::string Text() const; // The value as it would be rendered in TEXT format.
+};
+
+// ------------------------------------------------------------------------------------
+// Rendering, done by the logging thread.
+//
+// - Stream arguments are concatenated just as LoggingStream would have done.
+// - Printf arguments are substituted into the format string one conversion at a time.
+//   Anything that can't be formatted (not enough arguments, a type that doesn't match
+//   the conversion) is reported inline rather than throwing out of the logging thread.
+// ------------------------------------------------------------------------------------
+void RenderStreamArguments(const char* encoded, const size_t encodedSize, std::string& out);
+void RenderPrintfArguments(const char* format, const char* encoded, const size_t encodedSize, std::string& out);
+void RenderFields(const char* encoded, const size_t encodedSize, const FieldFormat f, std::string& out);
+
+// Looks up a field by key, returning false if the record doesn't have it.
+bool FindEncodedField(const char* encoded, const size_t encodedSize, const char* key, FieldValue& value);
+
+// ------------------------------------------------------------------------------------
+// Field keys are pointers, which only mean something in the process that logged them.
+// Exported fields have each key's characters (as a STRING) in front of its value instead,
+// so they can be handed to another process; importing turns the keys back into pointers
+// through internKey, which has to return a string that outlives the record.  Importing
+// returns false (leaving out as it was) if the fields don't make sense.
+// ------------------------------------------------------------------------------------
+void ExportFields(const char* encoded, const size_t encodedSize, std::string& out);
+bool ImportFields(const char* exported, const size_t exportedSize, const std::function<const char*(const char*, size_t)>& internKey, std::string& out);
@@ -1,607 +1,862 @@
-#include <thread>
-#include <atomic>
-#include <queue>
-#include <cstdint>
-#include <unordered_map>
-#include <future>
-#include <iterator>
-#include <condition_variable>
-
-#include <boost/lexical_cast.hpp>
-#include <boost/thread/locks.hpp>
-#include <boost/thread/shared_mutex.hpp>
-#include <boost/filesystem.hpp>
-
-#include "QueueWrapper.h"
-
-#include "LogAsync.h"
-#include "LogHandler.h"
-#include "SocketSender.h"
-
-#ifdef _MSC_VER
-#if _MSC_VER < 1900
-#define thread_local __declspec(thread)
-#endif
-#endif
-
-constexpr uint_fast32_t DEQUE_SIZE = 256;
-constexpr uint_fast32_t NUM_LOGGING_WORKERS = 2;
-
-
-static const std::array<const char*, 6> LOG_LEVELS =
-{
-	LOG_FATAL,
-	LOG_ERROR,
-	LOG_WARNING,
-	LOG_INFO,
-	LOG_DEBUG,
-	LOG_ALL
-};
-
-enum LOG_LEVELS_INTEGRAL
-{
-	LOG_FATAL_INT = 0,
-	LOG_ERROR_INT = 1,
-	LOG_WARNING_INT = 2,
-	LOG_INFO_INT = 3,
-	LOG_DEBUG_INT = 4,
-	LOG_ALL_INT = 5,
-};
-
-
-
-inline int64_t LogLevelPosition(const char* src)
-{
-	const auto position = std::find(LOG_LEVELS.begin(), LOG_LEVELS.end(), src);
-	if (position == LOG_LEVELS.end()) { return LOG_ALL_INT; }
-
-	return std::distance(LOG_LEVELS.begin(), position);
-}
-
-template <unsigned level>
-inline bool LogLevelAt(std::unordered_set<const char*>&& s)
-{
-	for (int i = level; i >= 0; --i)
-	{
-		if (s.find(LOG_LEVELS[i]) != s.end()) { return true; }
-	}
-	return false;
-}
-
-inline bool LogEverything(std::unordered_set<const char*>&& s) { return true; }
-
-// --------------------------------------------------------------------------------------------
-// Variables local/private to the Logging Namespace that are essential to run the various
-// logging functions.
-// --------------------------------------------------------------------------------------------
-namespace Logging
-{
-	// Matches to logging lines / id's for various logging methods ---------------
-	typedef std::shared_ptr<std::atomic<uint_fast32_t>> shared_uint32_ptr;
-	typedef std::shared_ptr<std::atomic<int_fast32_t>> shared_int32_ptr;
-
-	// "LogEvery" requires we keep track of the lines being logged on each thread.
-	// We don't want threads to conflict so we need some global access for lookups.
-	//
-	// Strangely enough, the logging every n per thread is more simple because
-	// it can be resolved with thread_locals without locks.
-	std::unordered_map<const char*, shared_uint32_ptr> loggingLineLookup;
-	boost::shared_mutex rwlock_loggingLine;
-
-	// Keep track of our logging queues and threads.  We want to take advantage of 
-	// multi-producer efficiencies in a queue but allow it to be processed and 
-	// sorted by a single consumer separately.  This facilitates the need to keep 
-	// a "swappable" queue at the ready, and work on a standby queue.
-	ConcurrentQueueWrapper asyncQueue;
-	std::unique_ptr<ThreadRAII> handle_queue;
-	std::unique_ptr<ThreadRAII> handle_disk;
-
-	// Allows us to stream on all threads from a different stream. ---------------
-	thread_local LoggingStream managed_stream;
-
-	std::function<bool(std::unordered_set<const char*>&&)> loggingLevelFilter = LogEverything;
-
-	// Keep track of all our logging systems.
-	std::vector<std::weak_ptr<LogBase>> allActiveLogs;
-	boost::shared_mutex logAdditionMutex;
-
-	// Disk space checking -------------------------------------------------------
-	volatile bool quitLogging = false;
-	volatile bool spaceExceeded = false;
-	double diskSpaceRatio = 1.0;
-
-	// Has our internal state been started? -------------------------------------
-	std::atomic<bool> initialized(false);
-
-	// Graceful program termination without needing to manually unregister something is good!
-	class LogRAII;
-	std::unique_ptr<LogRAII> terminate_logging;
-
-}
-
-// --------------------------------------------------------------------------------------------
-// Let's see if we can't use RAII to handle graceful program termination as well.
-// --------------------------------------------------------------------------------------------
-namespace Logging
-{
-	class LogRAII final
-	{
-	public:
-		LogRAII() {}
-		~LogRAII() { quitLogging = true; }
-	};
-}
-
-// --------------------------------------------------------------------------------------------
-// Common functions required of the logging system that may be used in later parts of the code
-// but are not declared above.
-// --------------------------------------------------------------------------------------------
-namespace Logging
-{
-
-	// ----------------------------------------------------------------------
-	// When is it acceptable to log data? Don't bother stressing the logging
-	// system if we don't have anything that we'll even need to log data to.
-	// ----------------------------------------------------------------------
-	bool IsLoggable(std::unordered_set<const char*>&& tags)
-	{
-		return !quitLogging && !spaceExceeded && !allActiveLogs.empty() && loggingLevelFilter(std::move(tags));
-	}
-
-	// ----------------------------------------------------------------------
-	// If we haven't seen a Logging Line, add it to the map.
-	// ----------------------------------------------------------------------
-	inline uint_fast32_t RegisterCountOf(const char* src)
-	{
-		boost::upgrade_lock<boost::shared_mutex> lock(rwlock_loggingLine);
-		boost::upgrade_to_unique_lock<boost::shared_mutex> uniqueLock(lock);
-
-		// Ensure we're actually the first entry and not just another thread
-		// that's waited for the mutex to clear at this point.
-		auto found = loggingLineLookup.find(src);
-		if (found == loggingLineLookup.end())
-		{
-			// Since we always fetch_add on a read, prime the value with 1 rather than 0
-			loggingLineLookup[src] = std::make_shared<shared_uint32_ptr::element_type>(1);
-			return 0;
-		}
-		return found->second->fetch_add(1);
-	}
-
-	// ----------------------------------------------------------------------
-	// Find the number of times a Logging Line has already been called,
-	// inserting a new entry into the map if it's the first time it's been used.
-	// ----------------------------------------------------------------------
-	inline uint_fast32_t GetCountOf(const char* src)
-	{
-		boost::shared_lock<boost::shared_mutex> lock(rwlock_loggingLine);
-		auto find_base = loggingLineLookup.find(src);
-		if (find_base == loggingLineLookup.end())
-		{
-			lock.unlock();
-			return RegisterCountOf(src);
-		}
-		return find_base->second->fetch_add(1);
-	}
-
-	// ----------------------------------------------------------------------
-	// Find the number of times an ID/Logging Line pair has already been
-	// called, inserting a new entry into the map if it's the first time
-	// it's been seen.  Obviously this becomes a problem if we have a bajilion
-	// threads running with these logging calls.
-	// ----------------------------------------------------------------------
-	inline uint_fast32_t GetCountOfID(uint_fast32_t id, const char* src)
-	{
-		static thread_local std::unordered_map<const char*, uint_fast32_t> loggingLineIDLookup;
-
-		auto find_base = loggingLineIDLookup.find(src);
-		if (find_base == loggingLineIDLookup.end())
-		{
-			loggingLineIDLookup[src] = 1;
-			return 0;
-		}
-		return find_base->second++;
-	}
-
-	// ----------------------------------------------------------------------
-	// Return a new RotatedLog based on an input filename that can be modified.
-	// As soon as it goes out of scope on the parent, it'll stop being logged
-	// by the logging system.
-	// ----------------------------------------------------------------------
-	inline std::shared_ptr<RotatedLog> CreateRotatedLog(const std::string& filename)
-	{
-		auto rotated = std::make_shared<RotatedLog>(filename);
-		return rotated;
-	}
-
-	template <class T>
-	inline std::shared_ptr<T> AddLogToSystem(std::shared_ptr<T> l)
-	{
-		InitLogging();
-		boost::shared_lock<boost::shared_mutex> lock(logAdditionMutex);
-		allActiveLogs.push_back(l);
-		return l;
-	}
-
-	std::shared_ptr<RotatedLog> RegisterLog(const std::string& filename)
-	{
-		auto rotated = CreateRotatedLog(filename);
-		rotated->SetDiskThresholdPercent(diskSpaceRatio);
-		return AddLogToSystem(rotated);
-	}
-	std::shared_ptr<RotatedLog> RegisterSizeRotatedLog(const std::string& filename, const uint64_t maxBytes, const unsigned numToRotateThrough)
-	{
-		auto rotated = CreateRotatedLog(filename);
-		rotated->ResetLogsAtSize(maxBytes, numToRotateThrough);
-		return AddLogToSystem(rotated);
-	}
-	std::shared_ptr<RotatedLog> RegisterPeriodRotatedLog(const std::string& filename, const uint64_t secondsPerLog, const unsigned numToRotateThrough)
-	{
-		auto rotated = CreateRotatedLog(filename);
-		rotated->ResetLogsAfterElapsed(secondsPerLog, numToRotateThrough);
-		return AddLogToSystem(rotated);
-	}
-	std::shared_ptr<RotatedLog> RegisterDailyLog(const std::string& filename, const unsigned hour, const unsigned minute, const unsigned second)
-	{
-		auto rotated = CreateRotatedLog(filename);
-		rotated->ResetLogsAtTime(hour, minute, second);
-		return AddLogToSystem(rotated);
-	}
-
-	std::shared_ptr<NetworkIO::LogSocket> RegisterUDPv4_Destination(const std::string& ip, const std::string& port)
-	{
-		auto socket = NetworkIO::RegisterUDPv4_Destination(ip, port);
-		return AddLogToSystem(socket);
-	}
-	std::shared_ptr<NetworkIO::LogSocket> RegisterUDPv6_Destination(const std::string& ip, const std::string& port)
-	{
-		auto socket = NetworkIO::RegisterUDPv6_Destination(ip, port);
-		return AddLogToSystem(socket);
-	}
-}
-
-// --------------------------------------------------------------------------------------------
-// Logging Stream Implementation details.
-// --------------------------------------------------------------------------------------------
-namespace Logging
-{
-	LoggingStream::LoggingStream() : _w(), _source(""), _tagFilter() {}
-	LoggingStream::~LoggingStream() {}
-
-	// ---------------------------------------------------------------------------
-	// Reset state and tag filters, as well as the source of the current line. 
-	// ---------------------------------------------------------------------------
-	void LoggingStream::SetSource(const char* src)
-	{
-		_tagFilter.clear();
-		_source = src;
-	}
-
-	// ---------------------------------------------------------------------------
-	// Tags needs to reset logging level so we don't erroneously look at tags
-	// for an older line if we call a new logging line without a prior std::endl.
-	// ---------------------------------------------------------------------------
-	void LoggingStream::SetTags(std::unordered_set<std::string>&& tags)
-	{
-		_tagFilter = std::move(tags);
-	}
-
-	// ---------------------------------------------------------------------------
-	// Terminate logging the line and wrap up what the thread local stream has
-	// collected. Additionally, it will clear and reset the stream so that it can 
-	// be used by other functions.
-	// ---------------------------------------------------------------------------
-	LoggingStream& LoggingStream::operator<<(StandardEndLine c)
-	{
-		asyncQueue.AddToQueue(LogData(std::move(_source), std::move(_tagFilter), std::move(_w.str())));
-		_w.clear();
-		return *this;
-	}
-}
-
-
-// --------------------------------------------------------------------------------------------
-// The meat of the logging system - queue handling and access functions.
-// --------------------------------------------------------------------------------------------
-namespace Logging
-{
-
-	// ---------------------------------------------------------------------------
-	// Remove extraneous log units if we noticed that some exist.
-	// ---------------------------------------------------------------------------
-	inline void HandleExpiredLogs(const unsigned numExpired)
-	{
-		// Only handle expired logs if we have a bunch of them to prevent any
-		// system running continuously that creates / stops using these from
-		// having some type of memory leak.
-		if (numExpired <= 4) { return; }
-
-		boost::upgrade_lock<boost::shared_mutex> lock(logAdditionMutex);
-		boost::upgrade_to_unique_lock<boost::shared_mutex> uniqueLock(lock);
-
-		allActiveLogs.erase(std::remove_if(allActiveLogs.begin(),
-										   allActiveLogs.end(),
-										   [](const std::weak_ptr<LogBase>& m) { return m.expired(); }),
-							allActiveLogs.end());
-	}
-
-	// ---------------------------------------------------------------------------
-	// NO_OP_MODE - testbed for working with purely unsorted queue sizes.
-	// ---------------------------------------------------------------------------
-	void HandleNoOpQueue(const volatile bool& quit)
-	{
-		std::vector<LogData> dataVec;
-		uint64_t numParsed = 0;
-		const auto start = steady_clock::now();
-
-		while (!quit)
-		{
-			asyncQueue.Dequeue(dataVec);
-			if (!dataVec.empty()) { numParsed += dataVec.size(); }
-			else { std::this_thread::sleep_for(milliseconds(1)); }
-		}
-		const auto end = steady_clock::now();
-		const auto elapsed = duration<double, std::milli>(end - start).count();
-
-		std::cout << "Processed " << numParsed << " messages in " << elapsed << "ms" << std::endl;
-		std::cout << "Average time to log each message: " << elapsed / numParsed << "ms" << std::endl;
-	}
-	// ---------------------------------------------------------------------------
-	// NO_OP_ORDERED - testbed for raw input/output used in sorted handling for
-	//                 the actual logging system.
-	// ---------------------------------------------------------------------------
-	void HandleNoOpQueueSorted(const volatile bool& quit)
-	{
-		std::vector<LogData> dataVec;
-		uint64_t numParsed = 0;
-		const auto start = steady_clock::now();
-
-		while (!quit)
-		{
-			asyncQueue.Dequeue(dataVec);
-			if (!dataVec.empty())
-			{
-				numParsed += dataVec.size();
-			}
-			else { std::this_thread::sleep_for(milliseconds(1)); }
-		}
-
-		const auto end = steady_clock::now();
-		const auto elapsed = duration<double, std::milli>(end - start).count();
-
-		std::cout << "Processed " << numParsed << " messages in " << elapsed << "ms" << std::endl;
-		std::cout << "Average time to log each message: " << elapsed / numParsed << "ms" << std::endl;
-	}
-
-	// ---------------------------------------------------------------------------
-	// Offload from the queue without caring about sorting.
-	// ---------------------------------------------------------------------------
-	void HandleUnsortedQueue(const volatile bool& quit)
-	{
-		std::vector<LogData> dataVec;
-
-		while (!quit)
-		{
-			std::vector<std::future<void>> futures;
-			asyncQueue.Dequeue(dataVec);
-			if (!dataVec.empty())
-			{
-				unsigned expiredLogs = 0;
-
-				// Lock Guard scoping
-				{
-					boost::shared_lock<boost::shared_mutex> lock(logAdditionMutex);
-
-					for (auto& weakRef : allActiveLogs)
-					{
-						if (auto strongRef = weakRef.lock())
-						{
-							futures.emplace_back(std::async([strongRef, &dataVec] { strongRef->HandleQueue(dataVec); }));
-						}
-						else { ++expiredLogs; }
-					}
-				}
-
-				for (auto& future : futures) { future.get(); }
-
-				HandleExpiredLogs(expiredLogs);
-			}
-			else { std::this_thread::sleep_for(milliseconds(1)); }
-		}
-	}
-
-
-	// ---------------------------------------------------------------------------
-	// Offload from the queue into a sorted way.
-	// ---------------------------------------------------------------------------
-	void HandleSortedQueue(const volatile bool& quit)
-	{
-		// Because the ConcurrentQueue buckets data by producer in order rather than
-		// purely in order, we need to extract and sort the input data in order for
-		// a sorted method - thus we need to exhaust the entire input queue.
-		std::vector<LogData> dataVec;
-	
-		while (!quit)
-		{
-			asyncQueue.Dequeue(dataVec);
-			if (!dataVec.empty())
-			{
-				std::vector<std::future<void>> futures;
-				unsigned expiredLogs = 0;
-
-				// Lock Guard scoping
-				{
-					boost::shared_lock<boost::shared_mutex> lock(logAdditionMutex);
-
-					for (auto& weakRef : allActiveLogs)
-					{
-						if (auto strongRef = weakRef.lock())
-						{
-							futures.emplace_back(std::async([strongRef, &dataVec] { strongRef->HandleQueue(dataVec); }));
-						}
-						else { ++expiredLogs; }
-					}
-				}
-
-				for (auto& future : futures) { future.get(); }
-				HandleExpiredLogs(expiredLogs);
-			}
-			else { std::this_thread::sleep_for(milliseconds(1)); }
-		}
-	}
-
-	// ---------------------------------------------------------------------------
-	// Initialize logging and get the processing threads ready.
-	//
-	// This will only occur once, and is called by the functions that distribute
-	// logging files / sockets out, so that there's no overhead if logging
-	// is not being used.
-	// ---------------------------------------------------------------------------
-	void InitLogging(const InitializationMode m)
-	{
-		if (!initialized.exchange(true))
-		{
-			// Manage the lifespan of the logging to the program
-			terminate_logging = std::make_unique<LogRAII>();
-
-			// Start up the worker thread
-			if (m == InitializationMode::ALLOW_UNORDERED)
-			{
-				handle_queue = std::make_unique<ThreadRAII>(HandleUnsortedQueue);
-				asyncQueue.HandleDataUnordered();
-			}
-			else if (m == InitializationMode::PERFECTLY_ORDERED)
-			{
-				handle_queue = std::make_unique<ThreadRAII>(HandleSortedQueue);
-				asyncQueue.HandleDataOrdered();
-			}
-			else if (m == InitializationMode::NO_OP_MODE)
-			{
-				handle_queue = std::make_unique<ThreadRAII>(HandleNoOpQueue);
-				asyncQueue.HandleDataUnordered();
-			}
-			else if (m == InitializationMode::NO_OP_ORDERED)
-			{
-				handle_queue = std::make_unique<ThreadRAII>(HandleNoOpQueueSorted);
-				asyncQueue.HandleDataOrdered();
-			}
-		}
-	}
-
-	// --------------------------------------------------------------------------------------------
-	// It is not necessary to call this function, but doing so ensures that any outstanding messages
-	// that have yet to be logged will be logged before the system is shut down.
-	// --------------------------------------------------------------------------------------------
-	void ShutdownLogging()
-	{
-		if (initialized)
-		{
-			// Don't allow new logging.
-			terminate_logging = nullptr;
-
-			// Allow the queue to finish up and flush entirely.
-			while (asyncQueue.GetRequestsRemaining() > 0) { std::this_thread::sleep_for(milliseconds(256)); }
-		}
-	}
-
-
-	// ---------------------------------------------------------------------------
-	// Filter all logs that aren't of a specified level.
-	// ---------------------------------------------------------------------------
-	void SetLoggingLevel(const char* level)
-	{
-		const auto position = LogLevelPosition(level);
-		switch (position)
-		{
-			case LOG_FATAL_INT:
-			{
-				loggingLevelFilter = &LogLevelAt<LOG_FATAL_INT>;
-				break;
-			}
-			case LOG_ERROR_INT:
-			{
-				loggingLevelFilter = &LogLevelAt<LOG_ERROR_INT>;
-				break;
-			}
-			case LOG_WARNING_INT:
-			{
-				loggingLevelFilter = &LogLevelAt<LOG_WARNING_INT>;
-				break;
-			}
-			case LOG_INFO_INT:
-			{
-				loggingLevelFilter = &LogLevelAt<LOG_INFO_INT>;
-				break;
-			}
-			case LOG_DEBUG_INT:
-			{
-				loggingLevelFilter = &LogLevelAt<LOG_DEBUG_INT>;
-				break;
-			}
-			case LOG_ALL_INT:
-			default:
-			{
-				loggingLevelFilter = LogEverything;
-				break;
-			}
-		}
-	}
-
-	// ---------------------------------------------------------------------------
-	// Returns the number of times a line of code has been logged by the system,
-	// so that we can log every n lines.
-	// ---------------------------------------------------------------------------
-	uint_fast32_t NumInstancesEvery(const char* src)
-	{
-		return GetCountOf(src);
-	}
-
-	// ---------------------------------------------------------------------------
-	// Returns the number of times a line of code has been logged by the system,
-	// so that we can log every n lines per id calling the function.
-	// ---------------------------------------------------------------------------
-	uint_fast32_t NumInstancesEveryID(uint_fast32_t id, const char* src)
-	{
-		return GetCountOfID(id, src);
-	}
-
-	// ---------------------------------------------------------------------------
-	// Called by all log stream code.
-	// ---------------------------------------------------------------------------
-	LoggingStream& GetLogStream(const char* src, std::unordered_set<std::string>&& tags)
-	{
-		managed_stream.SetSource(src);
-		managed_stream.SetTags(std::move(tags));
-		return managed_stream;
-	}
-
-	// ---------------------------------------------------------------------------
-	// Called by all printf logging code
-	// ---------------------------------------------------------------------------
-	void LogPrintfStyle(const char* src, std::unordered_set<std::string>&& tags, std::string&& logWhat)
-	{
-		asyncQueue.AddToQueue(LogData(src, std::move(tags), std::move(logWhat)));
-	}
-
-	void SetDiskSpaceThreshold(const double percent)
-	{
-		double sanitizedPercentage = std::min<double>(std::max<double>(percent / 100.0, 0.0), 1.0);
-
-		// Update only if the value has changed.
-		if (abs(sanitizedPercentage - diskSpaceRatio) < std::numeric_limits<double>::epsilon())
-		{
-			// Update disk space tracking for existing logs.
-			boost::shared_lock<boost::shared_mutex> lock(logAdditionMutex);
-			for (auto& input : allActiveLogs)
-			{
-				if (auto weakRef = input.lock())
-				{
-					if (auto toRotatedLog = std::dynamic_pointer_cast<RotatedLog>(weakRef))
-					{
-						toRotatedLog->SetDiskThresholdPercent(diskSpaceRatio);
-					}
-				}
-			}
-		}
-	}
-}
+#include <thread>
+#include <atomic>
+#include <queue>
+#include <cstdint>
+#include <unordered_map>
+#include <iterator>
+#include <condition_variable>
+#include <cstring>
+#include <array>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/filesystem.hpp>
+
+#include "QueueWrapper.h"
+#include "BufferPool.h"
+#include "SinkWorker.h"
+#include "SharedMemoryQueue.h"
+
+#include "LogAsync.h"
+#include "LogHandler.h"
+#include "SocketSender.h"
+
+#ifdef _MSC_VER
+#if _MSC_VER < 1900
+#define thread_local __declspec(thread)
+#endif
+#endif
+
+constexpr unsigned MAX_LOGGING_WORKERS = 0; // Default cap on the threads logs are written from; 0 gives each log its own.
+constexpr unsigned SHUTDOWN_FLUSH_SECONDS = 30; // How long ShutdownLogging waits for the logs to catch up before giving up on them.
+
+// LOG_ASYNC_EVERY_ID counts.  The table takes EVERY_ID_TABLE_SIZE * 8 bytes.
+constexpr size_t EVERY_ID_TABLE_SIZE = 1 << 16;
+constexpr size_t EVERY_ID_PROBE_LENGTH = 8;
+constexpr unsigned EVERY_ID_COUNT_BITS = 24;
+constexpr uint64_t EVERY_ID_COUNT_MASK = (1ull << EVERY_ID_COUNT_BITS) - 1;
+
+
+static const std::array<const char*, 6> LOG_LEVELS =
+{
+	LOG_FATAL,
+	LOG_ERROR,
+	LOG_WARNING,
+	LOG_INFO,
+	LOG_DEBUG,
+	LOG_ALL
+};
+
+inline int64_t LogLevelPosition(const char* src)
+{
+	const auto position = std::find_if(LOG_LEVELS.begin(), LOG_LEVELS.end(), [src](const char* level) { return strcmp(level, src) == 0; });
+	if (position == LOG_LEVELS.end()) { return LOG_ALL_INT; }
+
+	return std::distance(LOG_LEVELS.begin(), position);
+}
+
+// --------------------------------------------------------------------------------------------
+// Variables local/private to the Logging Namespace that are essential to run the various
+// logging functions.
+// --------------------------------------------------------------------------------------------
+namespace Logging
+{
+	// Keep track of our logging queues and threads.  We want to take advantage of 
+	// multi-producer efficiencies in a queue but allow it to be processed and 
+	// sorted by a single consumer separately.  This facilitates the need to keep 
+	// a "swappable" queue at the ready, and work on a standby queue.
+	ConcurrentQueueWrapper asyncQueue;
+
+	// (Line, ID) counts for LOG_ASYNC_EVERY_ID.  Zero means the slot is unused.
+	std::array<std::atomic<uint64_t>, EVERY_ID_TABLE_SIZE> everyIDCounts;
+
+	// Allows us to stream on all threads from a different stream. ---------------
+	thread_local LoggingStream managed_stream;
+
+	// The least severe level that will be logged.  Every logging line has a precomputed severity
+	// (LOG_NO_LEVEL_INT if it has no level), so filtering is a single comparison.
+	std::atomic<unsigned> loggingLevelThreshold(LOG_NO_LEVEL_INT);
+
+	// Are arguments formatted by the calling thread or the logging thread?
+	std::atomic<bool> deferredFormatting(false);
+
+	// Keep track of all our logging systems, and the workers they're spread over.
+	std::vector<std::weak_ptr<LogBase>> allActiveLogs;
+	std::vector<std::unique_ptr<SinkWorker>> sinkWorkers;
+	std::atomic<unsigned> maxSinkWorkers(MAX_LOGGING_WORKERS);
+
+	// Are express records written by the thread that logs them?  See SetExpressLevel.
+	std::atomic<bool> synchronousExpress(false);
+
+	// Set if records go to a collector process rather than the queue (see AttachToSharedQueue).
+	// It's never freed, as threads may log right up until the process exits.
+	std::atomic<SharedLaneWriter*> sharedLaneWriter(nullptr);
+	boost::shared_mutex logAdditionMutex;
+
+	// Flushes waiting for the logging thread to dispatch what they're waiting for: the number of
+	// records each producer had enqueued (see ConcurrentQueueWrapper::FlushTargets).
+	struct FlushRequest
+	{
+		std::vector<uint64_t> _targets;
+		std::shared_ptr<FlushBarrier> _barrier;
+	};
+	std::mutex flushLock;
+	std::vector<FlushRequest> pendingFlushes;
+	std::atomic<size_t> numPendingFlushes(0);
+
+	// Declared after sinkWorkers so that the threads using them are stopped before they go away.
+	std::unique_ptr<ThreadRAII> handle_queue;
+	std::unique_ptr<ThreadRAII> handle_disk;
+
+	// Collects records of other processes into the queue, so it's stopped before the queue goes away.
+	std::mutex collectorLock;
+	std::unique_ptr<SharedCollector> sharedCollector;
+
+	// Disk space checking -------------------------------------------------------
+	volatile bool quitLogging = false;
+	volatile bool spaceExceeded = false;
+	double diskSpaceRatio = 1.0;
+
+	// Has our internal state been started? -------------------------------------
+	std::atomic<bool> initialized(false);
+
+	// Graceful program termination without needing to manually unregister something is good!
+	class LogRAII;
+	std::unique_ptr<LogRAII> terminate_logging;
+
+}
+
+// --------------------------------------------------------------------------------------------
+// Let's see if we can't use RAII to handle graceful program termination as well.
+// --------------------------------------------------------------------------------------------
+namespace Logging
+{
+	class LogRAII final
+	{
+	public:
+		LogRAII() {}
+		~LogRAII() { quitLogging = true; }
+	};
+}
+
+// --------------------------------------------------------------------------------------------
+// Called by the crash handler, from a signal handler.  Records in the rings are written as they
+// are; everything else that's queued, or waiting for a sink thread, can only be counted.  Every
+// worker is posted the same batches in the same order, so the records some worker hasn't written
+// yet are the ones the furthest behind hasn't.  The workers are walked without a lock, like the
+// rings.
+// --------------------------------------------------------------------------------------------
+void WriteQueuedRecordsOnCrash(CrashWriter& w)
+{
+	const uint64_t numQueued = Logging::asyncQueue.QueuedOnCrash();
+	uint64_t numUndelivered = 0;
+	for (const auto& worker : Logging::sinkWorkers) { numUndelivered = std::max(numUndelivered, worker->NumUndelivered()); }
+	if (numQueued == 0 && numUndelivered == 0) { return; }
+
+	w.Append("*** LogAsync: ");
+	w.AppendNumber(numQueued);
+	w.Append(" records were still queued, and ");
+	w.AppendNumber(numUndelivered);
+	w.Append(" waiting for a sink thread ***\n");
+
+	const uint64_t numWritten = Logging::asyncQueue.PeekQueuedInRings([&w](const LogData& l) { AppendRecordOnCrash(w, l); });
+	if (numWritten < numQueued + numUndelivered)
+	{
+		w.Append("*** LogAsync: ");
+		w.AppendNumber(numQueued + numUndelivered - numWritten);
+		w.Append(" of them couldn't be reached ***\n");
+	}
+}
+
+// --------------------------------------------------------------------------------------------
+// Common functions required of the logging system that may be used in later parts of the code
+// but are not declared above.
+// --------------------------------------------------------------------------------------------
+namespace Logging
+{
+
+	// ----------------------------------------------------------------------
+	// When is it acceptable to log data? Don't bother stressing the logging
+	// system if we don't have anything that we'll even need to log data to.
+	// ----------------------------------------------------------------------
+	bool IsLoggable(const LogSite& site)
+	{
+		// A process attached to a shared queue has no logs of its own; the collector's logs take its records.
+		const bool hasLogs = !allActiveLogs.empty() || sharedLaneWriter.load(std::memory_order_relaxed) != nullptr;
+		return !quitLogging && !spaceExceeded && hasLogs && site._level <= loggingLevelThreshold.load(std::memory_order_relaxed);
+	}
+
+	// ----------------------------------------------------------------------
+	// Find the number of times an ID/Logging Line pair has already been
+	// called.
+	//
+	// Every slot in everyIDCounts packs a fingerprint of the (line, id) pair
+	// in its upper bits and the count in its lower bits, so a slot is read,
+	// claimed and counted with single atomic operations.  A pair can live in
+	// any of EVERY_ID_PROBE_LENGTH slots from where it hashes to; if they're
+	// all taken by other pairs, the one with the lowest count is evicted.
+	// ----------------------------------------------------------------------
+	inline uint64_t HashLineAndID(const void* lineAnchor, const uint64_t id)
+	{
+		// splitmix64 finalizer over the combined key.
+		uint64_t h = reinterpret_cast<uintptr_t>(lineAnchor) * 0x9E3779B97F4A7C15ull ^ id;
+		h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ull;
+		h = (h ^ (h >> 27)) * 0x94D049BB133111EBull;
+		return h ^ (h >> 31);
+	}
+
+	inline uint_fast32_t GetCountOfID(const uint64_t id, const void* lineAnchor)
+	{
+		const uint64_t hash = HashLineAndID(lineAnchor, id);
+
+		// The top bit is always set so that a claimed slot is never 0.
+		const uint64_t fingerprint = ((hash >> EVERY_ID_COUNT_BITS) | (1ull << (63 - EVERY_ID_COUNT_BITS))) << EVERY_ID_COUNT_BITS;
+		const size_t home = static_cast<size_t>(hash);
+
+		for (;;)
+		{
+			std::atomic<uint64_t>* victim = nullptr;
+			uint64_t victimValue = 0;
+
+			for (size_t probe = 0; probe < EVERY_ID_PROBE_LENGTH; ++probe)
+			{
+				std::atomic<uint64_t>& slot = everyIDCounts[(home + probe) & (EVERY_ID_TABLE_SIZE - 1)];
+				uint64_t value = slot.load(std::memory_order_relaxed);
+
+				for (;;)
+				{
+					if (value == 0)
+					{
+						if (slot.compare_exchange_weak(value, fingerprint | 1, std::memory_order_relaxed)) { return 0; }
+						continue;
+					}
+					if ((value & ~EVERY_ID_COUNT_MASK) != fingerprint) { break; }
+
+					const uint64_t count = value & EVERY_ID_COUNT_MASK;
+					if (slot.compare_exchange_weak(value, fingerprint | ((count + 1) & EVERY_ID_COUNT_MASK), std::memory_order_relaxed))
+					{
+						return static_cast<uint_fast32_t>(count);
+					}
+				}
+
+				if (victim == nullptr || (value & EVERY_ID_COUNT_MASK) < (victimValue & EVERY_ID_COUNT_MASK))
+				{
+					victim = &slot;
+					victimValue = value;
+				}
+			}
+
+			// Every slot belongs to another pair - take over the least used one.  If it changed
+			// underneath us, look through the slots again.
+			if (victim->compare_exchange_strong(victimValue, fingerprint | 1, std::memory_order_relaxed)) { return 0; }
+		}
+	}
+
+	// ----------------------------------------------------------------------
+	// Return a new RotatedLog based on an input filename that can be modified.
+	// As soon as it goes out of scope on the parent, it'll stop being logged
+	// by the logging system.
+	// ----------------------------------------------------------------------
+	inline std::shared_ptr<RotatedLog> CreateRotatedLog(const std::string& filename)
+	{
+		auto rotated = std::make_shared<RotatedLog>(filename);
+		return rotated;
+	}
+
+	template <class T>
+	inline std::shared_ptr<T> AddLogToSystem(std::shared_ptr<T> l)
+	{
+		InitLogging();
+		boost::unique_lock<boost::shared_mutex> lock(logAdditionMutex);
+
+		// Give the log a worker of its own (reusing one whose logs have all gone away), or once there's
+		// as many workers as SetSinkThreads allows, whichever of them has the fewest logs.
+		const size_t maxWorkers = maxSinkWorkers.load(std::memory_order_relaxed);
+		const size_t numEligible = maxWorkers == 0 ? sinkWorkers.size() : std::min(maxWorkers, sinkWorkers.size());
+		auto worker = std::min_element(sinkWorkers.begin(),
+									   sinkWorkers.begin() + numEligible,
+									   [](const std::unique_ptr<SinkWorker>& a, const std::unique_ptr<SinkWorker>& b) { return a->NumLogs() < b->NumLogs(); });
+		if (worker == sinkWorkers.begin() + numEligible || ((*worker)->NumLogs() != 0 && (maxWorkers == 0 || sinkWorkers.size() < maxWorkers)))
+		{
+			sinkWorkers.push_back(std::make_unique<SinkWorker>());
+			worker = sinkWorkers.end() - 1;
+		}
+		(*worker)->AddLog(l);
+		allActiveLogs.push_back(l);
+		return l;
+	}
+
+	std::shared_ptr<RotatedLog> RegisterLog(const std::string& filename)
+	{
+		auto rotated = CreateRotatedLog(filename);
+		rotated->SetDiskThresholdPercent(diskSpaceRatio);
+		return AddLogToSystem(rotated);
+	}
+	std::shared_ptr<RotatedLog> RegisterSizeRotatedLog(const std::string& filename, const uint64_t maxBytes, const unsigned numToRotateThrough)
+	{
+		auto rotated = CreateRotatedLog(filename);
+		rotated->ResetLogsAtSize(maxBytes, numToRotateThrough);
+		return AddLogToSystem(rotated);
+	}
+	std::shared_ptr<RotatedLog> RegisterPeriodRotatedLog(const std::string& filename, const uint64_t secondsPerLog, const unsigned numToRotateThrough)
+	{
+		auto rotated = CreateRotatedLog(filename);
+		rotated->ResetLogsAfterElapsed(secondsPerLog, numToRotateThrough);
+		return AddLogToSystem(rotated);
+	}
+	std::shared_ptr<RotatedLog> RegisterDailyLog(const std::string& filename, const unsigned hour, const unsigned minute, const unsigned second)
+	{
+		auto rotated = CreateRotatedLog(filename);
+		rotated->ResetLogsAtTime(hour, minute, second);
+		return AddLogToSystem(rotated);
+	}
+
+	std::shared_ptr<NetworkIO::LogSocket> RegisterUDPv4_Destination(const std::string& ip, const std::string& port)
+	{
+		auto socket = NetworkIO::RegisterUDPv4_Destination(ip, port);
+		return AddLogToSystem(socket);
+	}
+	std::shared_ptr<NetworkIO::LogSocket> RegisterUDPv6_Destination(const std::string& ip, const std::string& port)
+	{
+		auto socket = NetworkIO::RegisterUDPv6_Destination(ip, port);
+		return AddLogToSystem(socket);
+	}
+}
+
+// --------------------------------------------------------------------------------------------
+// Handing a finished record to the logging system.
+// --------------------------------------------------------------------------------------------
+namespace Logging
+{
+	// ---------------------------------------------------------------------------
+	// Synchronous express records are written by the calling thread.  Logs lock
+	// around HandleQueue, so at worst this waits for a batch a log is in the
+	// middle of writing.
+	// ---------------------------------------------------------------------------
+	void WriteRecordNow(LogData&& l)
+	{
+		l._timeLogged = CurrentClockCalibration().ToTimePoint(l._clockTicks);
+
+		std::vector<LogData> record;
+		record.push_back(std::move(l));
+		{
+			boost::shared_lock<boost::shared_mutex> lock(logAdditionMutex);
+			for (auto& log : allActiveLogs)
+			{
+				if (auto strongRef = log.lock()) { strongRef->HandleQueue(record); }
+			}
+		}
+		RecycleLogBuffers(record);
+	}
+
+	inline void SubmitRecord(LogData&& l)
+	{
+		if (SharedLaneWriter* writer = sharedLaneWriter.load(std::memory_order_acquire)) { writer->Write(l); }
+		else if (synchronousExpress.load(std::memory_order_relaxed) && asyncQueue.IsExpress(l)) { WriteRecordNow(std::move(l)); }
+		else { asyncQueue.AddToQueue(std::move(l)); }
+	}
+}
+
+// --------------------------------------------------------------------------------------------
+// Logging Stream Implementation details.
+// --------------------------------------------------------------------------------------------
+namespace Logging
+{
+	LoggingStream::LoggingStream() : _w(), _site(&UnknownLogSite()), _deferArguments(false), _arguments() {}
+	LoggingStream::~LoggingStream() {}
+
+	// ---------------------------------------------------------------------------
+	// Set the logging line (source, tags and level) the stream is collecting
+	// data for, so we don't erroneously look at an older line if we call a new
+	// logging line without a prior std::endl.
+	// ---------------------------------------------------------------------------
+	void LoggingStream::SetSite(const LogSite& site)
+	{
+		_site = &site;
+		_deferArguments = IsFormattingDeferred();
+	}
+
+	// ---------------------------------------------------------------------------
+	// Terminate logging the line and wrap up what the thread local stream has
+	// collected. Additionally, it will clear and reset the stream so that it can 
+	// be used by other functions.
+	// ---------------------------------------------------------------------------
+	LoggingStream& LoggingStream::operator<<(StandardEndLine c)
+	{
+		if (_deferArguments)
+		{
+			SubmitRecord(LogData(*_site, _arguments.data(), _arguments.size(), PayloadKind::DEFERRED_STREAM));
+			_arguments.clear();
+		}
+		else
+		{
+			SubmitRecord(LogData(*_site, _w.data(), _w.size()));
+			_w.clear();
+		}
+		return *this;
+	}
+}
+
+
+// --------------------------------------------------------------------------------------------
+// The meat of the logging system - queue handling and access functions.
+// --------------------------------------------------------------------------------------------
+namespace Logging
+{
+
+	// ---------------------------------------------------------------------------
+	// Remove extraneous log units if we noticed that some exist.
+	// ---------------------------------------------------------------------------
+	inline void HandleExpiredLogs(const unsigned numExpired)
+	{
+		// Only handle expired logs if we have a bunch of them to prevent any
+		// system running continuously that creates / stops using these from
+		// having some type of memory leak.
+		if (numExpired <= 4) { return; }
+
+		boost::upgrade_lock<boost::shared_mutex> lock(logAdditionMutex);
+		boost::upgrade_to_unique_lock<boost::shared_mutex> uniqueLock(lock);
+
+		allActiveLogs.erase(std::remove_if(allActiveLogs.begin(),
+										   allActiveLogs.end(),
+										   [](const std::weak_ptr<LogBase>& m) { return m.expired(); }),
+							allActiveLogs.end());
+		for (auto& worker : sinkWorkers) { worker->RemoveExpiredLogs(); }
+	}
+
+	// ---------------------------------------------------------------------------
+	// Post a barrier to every worker for each flush whose records have all been
+	// dispatched.  Workers handle their inboxes in order, so they reach it after
+	// writing those records.
+	// ---------------------------------------------------------------------------
+	inline void ServiceFlushes()
+	{
+		if (numPendingFlushes.load(std::memory_order_acquire) == 0) { return; }
+
+		std::lock_guard<std::mutex> lock(flushLock);
+		boost::shared_lock<boost::shared_mutex> logLock(logAdditionMutex);
+
+		const auto waiting = std::partition(pendingFlushes.begin(),
+											pendingFlushes.end(),
+											[](const FlushRequest& r) { return asyncQueue.FlushReached(r._targets); });
+		for (auto request = pendingFlushes.begin(); request != waiting; ++request)
+		{
+			request->_barrier->Posted(sinkWorkers.size());
+			for (auto& worker : sinkWorkers) { worker->PostBarrier(request->_barrier); }
+		}
+
+		pendingFlushes.erase(pendingFlushes.begin(), waiting);
+		numPendingFlushes.store(pendingFlushes.size(), std::memory_order_release);
+	}
+
+	// ---------------------------------------------------------------------------
+	// NO_OP_MODE - testbed for working with purely unsorted queue sizes.
+	// ---------------------------------------------------------------------------
+	void HandleNoOpQueue(const volatile bool& quit)
+	{
+		std::vector<LogData> dataVec;
+		IdleBackoff idle;
+		PlacedThread placed(LogThreadRole::QUEUE, "logasync-queue");
+		uint64_t numParsed = 0;
+		const auto start = steady_clock::now();
+
+		while (!quit)
+		{
+			placed.Refresh();
+			asyncQueue.Dequeue(dataVec);
+			if (!dataVec.empty())
+			{
+				idle.Reset();
+				numParsed += dataVec.size();
+				RecycleLogBuffers(dataVec);
+			}
+			else
+			{
+				ServiceFlushes();
+				asyncQueue.WaitForRecords(idle);
+			}
+		}
+		const auto end = steady_clock::now();
+		const auto elapsed = duration<double, std::milli>(end - start).count();
+
+		std::cout << "Processed " << numParsed << " messages in " << elapsed << "ms" << std::endl;
+		std::cout << "Average time to log each message: " << elapsed / numParsed << "ms" << std::endl;
+	}
+	// ---------------------------------------------------------------------------
+	// NO_OP_ORDERED - testbed for raw input/output used in sorted handling for
+	//                 the actual logging system.
+	// ---------------------------------------------------------------------------
+	void HandleNoOpQueueSorted(const volatile bool& quit)
+	{
+		std::vector<LogData> dataVec;
+		IdleBackoff idle;
+		PlacedThread placed(LogThreadRole::QUEUE, "logasync-queue");
+		uint64_t numParsed = 0;
+		steady_clock::duration ordering(0); // Time spent in Dequeue, which is where records get put in order.
+		const auto start = steady_clock::now();
+
+		while (!quit)
+		{
+			placed.Refresh();
+			const auto dequeueStart = steady_clock::now();
+			asyncQueue.Dequeue(dataVec);
+			ordering += steady_clock::now() - dequeueStart;
+			if (!dataVec.empty())
+			{
+				idle.Reset();
+				numParsed += dataVec.size();
+				RecycleLogBuffers(dataVec);
+			}
+			else
+			{
+				ServiceFlushes();
+				asyncQueue.WaitForRecords(idle);
+			}
+		}
+
+		const auto end = steady_clock::now();
+		const auto elapsed = duration<double, std::milli>(end - start).count();
+
+		std::cout << "Processed " << numParsed << " messages in " << elapsed << "ms" << std::endl;
+		std::cout << "Average time to log each message: " << elapsed / numParsed << "ms" << std::endl;
+		std::cout << "Dequeuing in order took " << duration<double, std::milli>(ordering).count() << "ms ("
+				  << duration<double, std::nano>(ordering).count() / numParsed << "ns per message)" << std::endl;
+	}
+
+	// ---------------------------------------------------------------------------
+	// Turn the raw clock readings taken by the logging threads into wall clock
+	// time, before any log looks at the records.
+	// ---------------------------------------------------------------------------
+	inline void ConvertTimestamps(std::vector<LogData>& dataVec)
+	{
+		if (dataVec.empty()) { return; }
+
+		const ClockCalibration calibration = CurrentClockCalibration();
+		for (auto& l : dataVec) { l._timeLogged = calibration.ToTimePoint(l._clockTicks); }
+	}
+
+	// ---------------------------------------------------------------------------
+	// Let every log know about records that were dropped because the queue was
+	// full.  They report it the next time they're handed records to log.
+	// ---------------------------------------------------------------------------
+	inline void ReportDroppedRecords()
+	{
+		const uint64_t numDropped = asyncQueue.TakeDroppedCount();
+		if (numDropped == 0) { return; }
+
+		boost::shared_lock<boost::shared_mutex> lock(logAdditionMutex);
+		for (auto& log : allActiveLogs)
+		{
+			if (auto strongRef = log.lock()) { strongRef->NoteDropped(numDropped); }
+		}
+	}
+
+	// ---------------------------------------------------------------------------
+	// Post the records to every worker that has logs.  The logs handle them on
+	// the workers' threads, so we can go straight back to the queue.  Express
+	// records go ahead of the batches already waiting for the workers.
+	// ---------------------------------------------------------------------------
+	inline void DispatchToLogs(std::vector<LogData>& dataVec, const bool express)
+	{
+		const LogBatch batch = MakeLogBatch(std::move(dataVec));
+		dataVec = TakeBatchStorage();
+		unsigned expiredLogs = 0;
+
+		// Lock Guard scoping
+		{
+			boost::shared_lock<boost::shared_mutex> lock(logAdditionMutex);
+
+			for (auto& log : allActiveLogs)
+			{
+				if (log.expired()) { ++expiredLogs; }
+			}
+			for (auto& worker : sinkWorkers)
+			{
+				if (worker->NumLogs() != 0) { worker->Post(batch, express); }
+			}
+		}
+
+		HandleExpiredLogs(expiredLogs);
+	}
+
+
+	// ---------------------------------------------------------------------------
+	// Offload from the queue and hand the records to the logs.  The queue puts
+	// them in whatever order the initialization mode asks for as it dequeues
+	// them, so this is the same for every mode.
+	// ---------------------------------------------------------------------------
+	void HandleLoggingQueue(const volatile bool& quit)
+	{
+		std::vector<LogData> dataVec;
+		IdleBackoff idle;
+		PlacedThread placed(LogThreadRole::QUEUE, "logasync-queue");
+
+		while (!quit)
+		{
+			placed.Refresh();
+			const bool express = asyncQueue.Dequeue(dataVec);
+			ConvertTimestamps(dataVec);
+			ReportDroppedRecords();
+			if (!dataVec.empty())
+			{
+				idle.Reset();
+				DispatchToLogs(dataVec, express);
+				ServiceFlushes();
+			}
+			else
+			{
+				ServiceFlushes();
+				asyncQueue.WaitForRecords(idle);
+			}
+		}
+	}
+
+	// ---------------------------------------------------------------------------
+	// Initialize logging and get the processing threads ready.
+	//
+	// This will only occur once, and is called by the functions that distribute
+	// logging files / sockets out, so that there's no overhead if logging
+	// is not being used.
+	// ---------------------------------------------------------------------------
+	void InitLogging(const InitializationMode m, const QueueEngine e, const ClockSource c)
+	{
+		if (!initialized.exchange(true))
+		{
+			// Manage the lifespan of the logging to the program
+			terminate_logging = std::make_unique<LogRAII>();
+
+			const ClockSource used = SetClockSource(c);
+			std::cerr << "Logging timestamps are taken from " << ClockSourceName(used) << "." << std::endl;
+
+			if (e == QueueEngine::PER_THREAD_RINGS) { asyncQueue.UseProducerRings(); }
+
+			// Tell the queue how to order records before anything dequeues them.
+			switch (m)
+			{
+				case InitializationMode::ALLOW_UNORDERED:
+				case InitializationMode::NO_OP_MODE:           { asyncQueue.HandleDataUnordered(); break; }
+				case InitializationMode::NEARLY_ORDERED:
+				case InitializationMode::NO_OP_NEARLY_ORDERED: { asyncQueue.HandleDataWindowed(); break; }
+				case InitializationMode::PERFECTLY_ORDERED:
+				case InitializationMode::NO_OP_ORDERED:
+				default:                                       { asyncQueue.HandleDataOrdered(); break; }
+			}
+
+			// Start up the worker thread
+			if (m == InitializationMode::NO_OP_MODE) { handle_queue = std::make_unique<ThreadRAII>(HandleNoOpQueue); }
+			else if (m == InitializationMode::NO_OP_ORDERED || m == InitializationMode::NO_OP_NEARLY_ORDERED) { handle_queue = std::make_unique<ThreadRAII>(HandleNoOpQueueSorted); }
+			else { handle_queue = std::make_unique<ThreadRAII>(HandleLoggingQueue); }
+		}
+	}
+
+	ClockSource ActiveClockSource()
+	{
+		return ActiveClockSourceRef().load(std::memory_order_relaxed);
+	}
+
+	void SetReorderWindow(const milliseconds window)
+	{
+		asyncQueue.SetReorderWindow(window);
+	}
+
+	void SetSinkThreads(const unsigned numThreads)
+	{
+		maxSinkWorkers = numThreads;
+	}
+
+	// --------------------------------------------------------------------------------------------
+	// The flush is queued for the logging thread, which hands it to the workers once it's
+	// dispatched everything that had been enqueued by now.  Waking it up means a flush doesn't wait
+	// out the logging thread's sleep.
+	// --------------------------------------------------------------------------------------------
+	bool Flush(const milliseconds timeout, const bool sync)
+	{
+		if (!initialized) { return true; }
+
+		auto barrier = std::make_shared<FlushBarrier>(sync);
+		{
+			std::lock_guard<std::mutex> lock(flushLock);
+			pendingFlushes.push_back({asyncQueue.FlushTargets(), barrier});
+			numPendingFlushes.store(pendingFlushes.size(), std::memory_order_release);
+		}
+		asyncQueue.Wake();
+
+		return barrier->WaitFor(timeout);
+	}
+
+	// --------------------------------------------------------------------------------------------
+	// It is not necessary to call this function, but doing so ensures that any outstanding messages
+	// that have yet to be logged will be logged before the system is shut down.
+	// --------------------------------------------------------------------------------------------
+	void ShutdownLogging()
+	{
+		if (initialized)
+		{
+			// Don't allow new logging.
+			terminate_logging = nullptr;
+			StopCollector();
+
+			// Allow the queue to finish up and flush entirely, and the logs to write out what they were given.
+			// A log that's stuck (on a full disk, or a socket that's gone quiet) mustn't hang the process on
+			// its way out, though.
+			unsigned waited = 0;
+			while (!Flush(seconds(1)))
+			{
+				if (++waited == SHUTDOWN_FLUSH_SECONDS)
+				{
+					std::cerr << "WARNING - The logs didn't catch up within " << SHUTDOWN_FLUSH_SECONDS << " seconds of shutting down; some records may not have been written." << std::endl;
+					break;
+				}
+			}
+		}
+	}
+
+
+	// ---------------------------------------------------------------------------
+	// Sharing one queue between processes.
+	// ---------------------------------------------------------------------------
+	bool AttachToSharedQueue(const std::string& name)
+	{
+		std::lock_guard<std::mutex> lock(collectorLock);
+		if (sharedCollector || sharedLaneWriter.load() != nullptr)
+		{
+			std::cerr << "ERROR - This process is already collecting or attached to a shared logging queue!" << std::endl;
+			return false;
+		}
+
+		auto writer = SharedLaneWriter::Open(name);
+		if (!writer) { return false; }
+
+		sharedLaneWriter = writer.release();
+		return true;
+	}
+
+	bool StartCollector(const std::string& name, const unsigned numLanes, const uint64_t laneBytes)
+	{
+		std::lock_guard<std::mutex> lock(collectorLock);
+		if (!initialized || sharedCollector || sharedLaneWriter.load() != nullptr)
+		{
+			std::cerr << "ERROR - A collector needs InitLogging, and a process that isn't already collecting or attached to a shared logging queue!" << std::endl;
+			return false;
+		}
+
+		sharedCollector = SharedCollector::Create(name, numLanes, laneBytes, [](LogData&& l) { asyncQueue.AddToQueue(std::move(l)); });
+		return sharedCollector != nullptr;
+	}
+
+	void StopCollector()
+	{
+		std::lock_guard<std::mutex> lock(collectorLock);
+		sharedCollector = nullptr;
+	}
+
+	// ---------------------------------------------------------------------------
+	// Bound the memory used by records waiting in the queue.
+	// ---------------------------------------------------------------------------
+	void SetQueueMemoryLimit(const uint64_t maxBytes, const OverflowPolicy p)
+	{
+		asyncQueue.SetMemoryLimit(maxBytes, p);
+	}
+
+	void SetExpressLevel(const char* level, const bool synchronous)
+	{
+		const int64_t position = level == nullptr ? LOG_EXPRESS_OFF : LogLevelPosition(level);
+		asyncQueue.SetExpressLevel(position == LOG_ALL_INT ? static_cast<int>(LOG_NO_LEVEL_INT) : static_cast<int>(position));
+		synchronousExpress = synchronous;
+	}
+
+	void SetOverflowKeepLevel(const char* level)
+	{
+		const auto position = LogLevelPosition(level);
+		asyncQueue.SetKeepLevel(position == LOG_ALL_INT ? static_cast<unsigned>(LOG_NO_LEVEL_INT) : static_cast<unsigned>(position));
+	}
+
+	void SetOverflowSpinTime(const microseconds t)
+	{
+		asyncQueue.SetSpinTime(t);
+	}
+
+	uint64_t NumDroppedMessages()
+	{
+		return asyncQueue.GetDroppedTotal();
+	}
+
+	// ---------------------------------------------------------------------------
+	// Filter all logs that aren't of a specified level.
+	// ---------------------------------------------------------------------------
+	void SetLoggingLevel(const char* level)
+	{
+		// LOG_ALL logs everything, including lines without any logging level.
+		const auto position = LogLevelPosition(level);
+		loggingLevelThreshold = (position == LOG_ALL_INT) ? static_cast<unsigned>(LOG_NO_LEVEL_INT) : static_cast<unsigned>(position);
+	}
+
+	// ---------------------------------------------------------------------------
+	// Returns the number of times a line of code has been logged by the system,
+	// so that we can log every n lines per id calling the function.
+	// ---------------------------------------------------------------------------
+	uint_fast32_t NumInstancesEveryID(const uint64_t id, const void* lineAnchor)
+	{
+		return GetCountOfID(id, lineAnchor);
+	}
+
+	// ---------------------------------------------------------------------------
+	// Called by all log stream code.
+	// ---------------------------------------------------------------------------
+	LoggingStream& GetLogStream(const LogSite& site)
+	{
+		managed_stream.SetSite(site);
+		return managed_stream;
+	}
+
+	// ---------------------------------------------------------------------------
+	// Called by all printf logging code
+	// ---------------------------------------------------------------------------
+	void LogPrintfStyle(const LogSite& site, std::string&& logWhat)
+	{
+		SubmitRecord(LogData(site, std::move(logWhat)));
+	}
+
+	void LogPrintfStyleDeferred(const LogSite& site, const char* format, std::string&& encodedArgs)
+	{
+		SubmitRecord(LogData(site, std::move(encodedArgs), PayloadKind::DEFERRED_PRINTF, format));
+	}
+
+	void LogFields(const LogSite& site, std::string&& fields)
+	{
+		SubmitRecord(LogData(site, std::move(fields), PayloadKind::FIELDS));
+	}
+
+	void SetFormattingMode(const FormattingMode m)
+	{
+		deferredFormatting = (m == FormattingMode::DEFERRED);
+	}
+
+	bool IsFormattingDeferred()
+	{
+		return deferredFormatting.load(std::memory_order_relaxed);
+	}
+
+	void SetDiskSpaceThreshold(const double percent)
+	{
+		double sanitizedPercentage = std::min<double>(std::max<double>(percent / 100.0, 0.0), 1.0);
+
+		// Update only if the value has changed.
+		if (abs(sanitizedPercentage - diskSpaceRatio) < std::numeric_limits<double>::epsilon())
+		{
+			// Update disk space tracking for existing logs.
+			boost::shared_lock<boost::shared_mutex> lock(logAdditionMutex);
+			for (auto& input : allActiveLogs)
+			{
+				if (auto weakRef = input.lock())
+				{
+					if (auto toRotatedLog = std::dynamic_pointer_cast<RotatedLog>(weakRef))
+					{
+						toRotatedLog->SetDiskThresholdPercent(diskSpaceRatio);
+					}
+				}
+			}
+		}
+	}
+}
@@ -1,221 +1,525 @@
-#pragma once
-
-// ------------------------------------------------------------------------------------
-//  LogAsync - An asynchronous, ordered, logging wrapper intended to make it easier
-//             to log data in critical sections of code without blocking as long for a
-//             logging call.
-//
-//             At the moment, it's intended to be a wrapper that is threadsafe, 
-//             order-preserving, reasonably fast, and relatively lightweight to use
-//
-//             It's primitive and doesn't do anything fancy, and it's easy to plug
-//             in GLOG, Log4cxx, or another logging system to work on the backend
-//             of this.  It defaults to logging via     .
-// ------------------------------------------------------------------------------------
-
-#include <iostream>
-#include <string>
-#include <sstream>
-#include <functional>
-#include <vector>
-#include <tuple>
-#include <memory>
-#include <cstdint>
-#include <unordered_set>
-
-#include <fmt/format.h>
-#include <fmt/ostream.h>
-#include <fmt/printf.h>
-
-#include "LogHandler.h"
-#include "SocketSender.h"
-
-#define STRINGIFY(x) #x
-#define TOSTRING(x) STRINGIFY(x)
-#define AT __FILE__ "::" TOSTRING(__LINE__)
-
-// --------------------------------------------------------------------------------------------
-// Logging stream macros - these are used to stream (and log) data, and must be terminated with
-// a std::endl for the logging to occur correctly.
-//
-// Logging is based on tags, not on levels.  This is an intentional choice - tags are more
-// descriptive than logging levels and allow for much more complex organization of file data.
-//
-// !!! WARNING !!!  ONLY USE ONE LINE PER LOG.  DON'T USE MULTIPLE LOGGING TAGS IN ANY LINE OF
-//                  CODE, OR THE SYSTEM WILL NOT BE ABLE TO HANDLE YOUR INPUT PROPERLY.
-//
-// !!! WARNING !!!  The system expects that all tags are constant and do not change dynamically
-//                  at runtime.  Writing code that does so will likely interfere with the correct
-//                  logging operation of the system.
-//
-// !!! WARNING !!!  For speed purposes, tags logged to LOG_ASYNC_EVERY_ID use thread local
-//                  storage.  If you don't 
-// --------------------------------------------------------------------------------------------
-
-static const char* const LOG_FATAL   = "LOG_FATAL"; // Does not call std::terminate; just treated as a level.
-static const char* const LOG_ERROR   = "LOG_ERROR";
-static const char* const LOG_WARNING = "LOG_WARN";
-static const char* const LOG_INFO    = "LOG_INFO";
-static const char* const LOG_DEBUG   = "LOG_DEBUG";
-static const char* const LOG_ALL     = "LOG_ALL"; // Allows everything to be logged, even if no logging level tags are provided.
-
-#define LOG_ASYNC(...) if (::Logging::IsLoggable({__VA_ARGS__})) ::Logging::GetLogStream(AT, {__VA_ARGS__})
-#define LOG_ASYNC_IF(expr, ...) if (expr) LOG_ASYNC(__VA_ARGS__)
-#define LOG_ASYNC_EVERY(n, ...) if (::Logging::IsLoggableEvery<n>(AT)) LOG_ASYNC(__VA_ARGS__)
-#define LOG_ASYNC_EVERY_ID(id, n, ...) if (::Logging::IsLoggibleEveryID<n>(id,AT)) LOG_ASYNC(__VA_ARGS__)
-
-// We're compatible with printf style stuff too, but it's won't be quite as clean to set up.
-// TAGS should be formatted as follows:
-// { "Tag1", "Tag2", .... , "Pizza" }
-//
-// One thing to note is that GCC handles variadic macros differently than Visual Studio,
-// we we need to have a switch between them for them to exhibit the same behavior.
-
-
-#ifdef _MSC_VER
-
-    #define LOG_ASYNC_C(tags, fmt, ...) if (::Logging::IsLoggable(tags)) ::Logging::HandlePrintfStyle(AT, tags, fmt, __VA_ARGS__)
-    #define LOG_ASYNC_IF_C(expr, tags, fmt, ...) if (expr) LOG_ASYNC_C(tags, fmt, __VA_ARGS__)
-    #define LOG_ASYNC_EVERY_C(n, tags, fmt, ...) if (::Logging::IsLoggableEvery<n>(AT)) LOG_ASYNC_C(tags, fmt, __VA_ARGS__)
-    #define LOG_ASYNC_EVERY_ID_C(id, n, tags, fmt, ...) if (::Logging::IsLoggibleEveryID<n>(id,AT)) LOG_ASYNC_C(tags, fmt, __VA_ARGS__)
-
-#else //This supports GCC, I don't know what format Clang would require for this.
-
-    #define LOG_ASYNC_C(tags, fmt, ...) if (::Logging::IsLoggable(tags)) ::Logging::HandlePrintfStyle(AT, tags, fmt, ##__VA_ARGS__)
-    #define LOG_ASYNC_IF_C(expr, tags, fmt, ...) if (expr) LOG_ASYNC_C(tags, fmt, ##__VA_ARGS__)
-    #define LOG_ASYNC_EVERY_C(n, tags, fmt, ...) if (::Logging::IsLoggableEvery<n>(AT)) LOG_ASYNC_C(tags, fmt, ##__VA_ARGS__)
-    #define LOG_ASYNC_EVERY_ID_C(id, n, tags, fmt, ...) if (::Logging::IsLoggibleEveryID<n>(id,AT)) LOG_ASYNC_C(tags, fmt, ##__VA_ARGS__)
-
-#endif
-
-
-namespace Logging
-{
-    // --------------------------------------------------------------------------------------------
-    // Add a log that will process through the input data we have.
-    // --------------------------------------------------------------------------------------------
-    std::shared_ptr<RotatedLog> RegisterLog(const std::string& filename);
-    std::shared_ptr<RotatedLog> RegisterSizeRotatedLog(const std::string& filename, const uint64_t maxBytes, const unsigned numToRotateThrough);
-    std::shared_ptr<RotatedLog> RegisterPeriodRotatedLog(const std::string& filename, const uint64_t secondsPerLog, const unsigned numToRotateThrough);
-    std::shared_ptr<RotatedLog> RegisterDailyLog(const std::string& filename, const unsigned hour, const unsigned minute, const unsigned second);
-    
-    std::shared_ptr<NetworkIO::LogSocket> RegisterUDPv4_Destination(const std::string& ip, const std::string& port);
-    std::shared_ptr<NetworkIO::LogSocket> RegisterUDPv6_Destination(const std::string& ip, const std::string& port);
-
-    // --------------------------------------------------------------------------------------------
-    // Do we even need to log anything?
-    // If we don't have anything that needs to be logged, there's no sense in even trying to
-    // queue/dequeue logs that won't even be logged...
-    // --------------------------------------------------------------------------------------------
-    bool IsLoggable(std::unordered_set<const char*>&& tags);
-
-    // --------------------------------------------------------------------------------------------
-    // Sets up the logging system.  It isn't necessary to call this function, because it's called
-    // by RegisterSocketLog and RegisterRotatedLog functions.
-    // --------------------------------------------------------------------------------------------
-	enum class InitializationMode
-	{
-		PERFECTLY_ORDERED, // Force all queue entries to be time synchronized - this is slower.
-		ALLOW_UNORDERED,   // Ignore the need to perfectly order entries in a queue.
-
-		// TESTING MODES, IGNORE THESE UNLESS YOU NEED TO TEST FORMATTING SPEED OR QUEUE SPEED
-		NO_OP_MODE,        // [Unordered Queue Removal]
-		NO_OP_ORDERED,     // [Queue is sorted by timestamp]
-	};
-
-    void InitLogging(const InitializationMode m = InitializationMode::PERFECTLY_ORDERED);
-
-    // --------------------------------------------------------------------------------------------
-    // It is not necessary to call this function, but doing so ensures that any outstanding messages
-    // that have yet to be logged will be logged before the system is shut down.
-    // --------------------------------------------------------------------------------------------
-    void ShutdownLogging();
-
-    // --------------------------------------------------------------------------------------------
-    // Logs a certain line only x number of times.  Each time this block of code is hit, the
-    // repetition count increases by 1.  This rolls around over a uint_fast32_t, which has a 
-    // side effect of causing a log to be logged even if it hasn't reached n iterations.
-    //
-    // Assumptions:  Each line of code contains AT MOST ONE reference to this function (i.e.
-    //               keep each log on a separate line or else we can't track the entries properly).
-    // --------------------------------------------------------------------------------------------
-    uint_fast32_t NumInstancesEvery(const char* src);
-    uint_fast32_t NumInstancesEveryID(uint_fast32_t id, const char* src);
-
-    template<unsigned LOG_FREQUENCY> inline bool IsLoggableEvery(const char* src)
-    {
-        return NumInstancesEvery(src) % LOG_FREQUENCY == 0;
-    }
-
-    template<unsigned LOG_FREQUENCY> inline bool IsLoggibleEveryID(const uint_fast32_t id, const char* src)
-    {
-        return NumInstancesEveryID(id, src) % LOG_FREQUENCY == 0;
-    }
-
-    // --------------------------------------------------------------------------------------------
-    // LoggingStream is the streamable interface that the LOG_ASYNC macros return.
-    //
-    // std::endl is a termination flag that indicates that the streamed content should be
-    // sent to the logging system; any lines not containing this flag will not behave as intended.
-    // --------------------------------------------------------------------------------------------
-    class LoggingStream
-    {
-    private:
-		fmt::MemoryWriter _w;
-        std::string _source;
-        std::unordered_set<std::string> _tagFilter;
-        typedef std::basic_ostream<char, std::char_traits<char> > CoutType;
-        typedef CoutType& (*StandardEndLine)(CoutType&);
-
-    public:
-        LoggingStream();
-        ~LoggingStream();
-
-        // --------------------------------------------------------------------------------------------
-        // Configure parts of the stream that the logging system will need to log later on.
-		// These don't need to be called by users of the logging system.
-        // --------------------------------------------------------------------------------------------
-        void SetSource(const char* s);
-        void SetTags(std::unordered_set<std::string>&& tags);
-
-		// --------------------------------------------------------------------------------------------
-		// Handle the input data we're actually logging.
-		// Since std::endl acts as a logging terminator, it needs to be handled individually.
-		// --------------------------------------------------------------------------------------------
-
-        LoggingStream& operator<<(StandardEndLine c);
-        template <class T> LoggingStream& operator<<(const T& o) { _w << o; return *this; }
-
-    };
-
-    // --------------------------------------------------------------------------------------------
-    // Helper method called by LOG_ASYNC macros to obtain a thread-local LoggingStream.
-    // --------------------------------------------------------------------------------------------
-    LoggingStream& GetLogStream(const char* src, std::unordered_set<std::string>&& tags);
-
-	// --------------------------------------------------------------------------------------------
-	// Methods called by the prinf style logging stuff.
-	// --------------------------------------------------------------------------------------------
-	void LogPrintfStyle(const char* src, std::unordered_set<std::string>&& tags, std::string&& logWhat);
-
-	template <class ...Args>
-	inline void HandlePrintfStyle(const char* src, std::unordered_set<std::string>&& tags, const char* format, Args&& ...args)
-	{
-		LogPrintfStyle(src, std::move(tags), fmt::sprintf(format, std::forward<Args>(args)...));
-	}
-	inline void HandlePrintfStyleEmpty(const char* src, std::unordered_set<std::string>&& tags, const char* format)
-	{
-		LogPrintfStyle(src, std::move(tags), format);
-	}
-
-    void SetLoggingLevel(const char* level);
-
-	// --------------------------------------------------------------------------------------------
-	// Ignore logging if the disk space is above a certain percentage.
-	// - 0.0 means no logging will occur (will stop logging at 0% full)
-	// - 100.0 means log until disk space is full.
-	// - New logs are ENTIRELY IGNORED if the disk space criteria is met.
-	// --------------------------------------------------------------------------------------------
-	
-	void SetDiskSpaceThreshold(const double percentage);
+#pragma once
+
+// ------------------------------------------------------------------------------------
+//  LogAsync - An asynchronous, ordered, logging wrapper intended to make it easier
+//             to log data in critical sections of code without blocking as long for a
+//             logging call.
+//
+//             At the moment, it's intended to be a wrapper that is threadsafe, 
+//             order-preserving, reasonably fast, and relatively lightweight to use
+//
+//             It's primitive and doesn't do anything fancy, and it's easy to plug
+//             in GLOG, Log4cxx, or another logging system to work on the backend
+//             of this.  It defaults to logging via     .
+// ------------------------------------------------------------------------------------
+
+#include <iostream>
+#include <string>
+#include <sstream>
+#include <functional>
+#include <vector>
+#include <tuple>
+#include <memory>
+#include <cstdint>
+#include <atomic>
+
+#include <fmt/format.h>
+#include <fmt/ostream.h>
+#include <fmt/printf.h>
+
+#include "LogTags.h"
+#include "LogArguments.h"
+#include "BufferPool.h"
+#include "LogHandler.h"
+#include "SocketSender.h"
+#include "CrashHandler.h"
+#include "ThreadPlacement.h"
+
+#define STRINGIFY(x) #x
+#define TOSTRING(x) STRINGIFY(x)
+#define AT __FILE__ "::" TOSTRING(__LINE__)
+
+// --------------------------------------------------------------------------------------------
+// Logging stream macros - these are used to stream (and log) data, and must be terminated with
+// a std::endl for the logging to occur correctly.
+//
+// Logging is based on tags, not on levels.  This is an intentional choice - tags are more
+// descriptive than logging levels and allow for much more complex organization of file data.
+//
+// !!! WARNING !!!  ONLY USE ONE LINE PER LOG.  DON'T USE MULTIPLE LOGGING TAGS IN ANY LINE OF
+//                  CODE, OR THE SYSTEM WILL NOT BE ABLE TO HANDLE YOUR INPUT PROPERLY.
+//
+// !!! WARNING !!!  Tags must be constant.  A line's tags are evaluated once, the first time it's
+//                  hit, and kept for every call after that, so tags can't name local variables
+//                  (that won't compile); globals and function calls compile, but only their
+//                  first value is ever used.
+//
+// !!! WARNING !!!  LOG_ASYNC_EVERY_ID keeps its counts in a fixed size table shared by every
+//                  line and id.  If far more (line, id) pairs are active than fit in the table,
+//                  the least used pairs are forgotten and their next hit is logged again.
+// --------------------------------------------------------------------------------------------
+
+// Logging levels (LOG_FATAL, LOG_ERROR, ...) are declared in LogTags.h.
+
+// Every logging line owns a static LogSite holding its source, level and interned tags.  It's
+// built the first time the line is hit, so the logging call itself never builds or hashes a set
+// of tags or copies the source into the record.  LOG_ASYNC_SITE takes the tags as macro
+// arguments, and LOG_ASYNC_SITE_LIST takes them as a braced list - { "Tag1", "Tag2" }.  The
+// lambdas capture nothing, so tags that change at runtime are rejected by the compiler.
+#define LOG_ASYNC_SITE(...) []() -> const LogSite& { static const LogSite lineSite(AT, TagSet{__VA_ARGS__}); return lineSite; }()
+#define LOG_ASYNC_SITE_LIST(tags) []() -> const LogSite& { static const LogSite lineSite(AT, TagSet tags); return lineSite; }()
+
+#define LOG_ASYNC(...) if (const LogSite* LOG_ASYNC_SITE_ = ::Logging::LoggableSite(LOG_ASYNC_SITE(__VA_ARGS__))) ::Logging::GetLogStream(*LOG_ASYNC_SITE_)
+#define LOG_ASYNC_IF(expr, ...) if (expr) LOG_ASYNC(__VA_ARGS__)
+// Every LOG_ASYNC_EVERY line also owns a static counter, so counting a hit is a single atomic add.
+#define LOG_ASYNC_EVERY_COUNTER() []() -> ::Logging::LineCounter& { static ::Logging::LineCounter lineCounter; return lineCounter; }()
+
+// LOG_ASYNC_EVERY_ID lines are identified by the address of a static anchor, which is combined
+// with the id to look up the count.
+#define LOG_ASYNC_EVERY_ID_ANCHOR() []() -> const void* { static const char lineAnchor = 0; return &lineAnchor; }()
+
+#define LOG_ASYNC_EVERY(n, ...) if (::Logging::IsLoggableEvery<n>(LOG_ASYNC_EVERY_COUNTER())) LOG_ASYNC(__VA_ARGS__)
+#define LOG_ASYNC_EVERY_ID(id, n, ...) if (::Logging::IsLoggibleEveryID<n>(id, LOG_ASYNC_EVERY_ID_ANCHOR())) LOG_ASYNC(__VA_ARGS__)
+
+// Logs typed key/value fields rather than a message: LOG_ASYNC_KV("Tag")("latency_us", x)("user", name);
+// The record is logged at the end of the statement.  Keys must be string literals.
+#define LOG_ASYNC_KV(...) if (const LogSite* LOG_ASYNC_SITE_ = ::Logging::LoggableSite(LOG_ASYNC_SITE(__VA_ARGS__))) ::Logging::FieldBuilder{*LOG_ASYNC_SITE_}
+
+// Logs a line at most perSecond times a second on average, in bursts of up to burst lines.  The
+// first line logged after some were held back says how many were.  Lines that wouldn't be logged
+// anyway (because of their level) don't use up the rate.  See Logging::RateLimiter.
+#define LOG_ASYNC_RATE_LIMITER() []() -> ::Logging::RateLimiter& { static ::Logging::RateLimiter lineLimiter; return lineLimiter; }()
+#define LOG_ASYNC_RATE(perSecond, burst, ...) if (const LogSite* LOG_ASYNC_SITE_ = ::Logging::LoggableSite(LOG_ASYNC_SITE(__VA_ARGS__))) if (::Logging::RateLimiter* LOG_ASYNC_LIMITER_ = ::Logging::PassesRateLimit(LOG_ASYNC_RATE_LIMITER(), perSecond, burst)) ::Logging::GetLogStream(*LOG_ASYNC_SITE_) << ::Logging::TakeSuppressedNote(*LOG_ASYNC_LIMITER_)
+
+// We're compatible with printf style stuff too, but it's won't be quite as clean to set up.
+// TAGS should be formatted as follows:
+// { "Tag1", "Tag2", .... , "Pizza" }
+//
+// One thing to note is that GCC handles variadic macros differently than Visual Studio,
+// we we need to have a switch between them for them to exhibit the same behavior.
+
+
+#ifdef _MSC_VER
+
+    #define LOG_ASYNC_C(tags, fmt, ...) if (const LogSite* LOG_ASYNC_SITE_ = ::Logging::LoggableSite(LOG_ASYNC_SITE_LIST(tags))) ::Logging::HandlePrintfStyle(*LOG_ASYNC_SITE_, fmt, __VA_ARGS__)
+    #define LOG_ASYNC_IF_C(expr, tags, fmt, ...) if (expr) LOG_ASYNC_C(tags, fmt, __VA_ARGS__)
+    #define LOG_ASYNC_EVERY_C(n, tags, fmt, ...) if (::Logging::IsLoggableEvery<n>(LOG_ASYNC_EVERY_COUNTER())) LOG_ASYNC_C(tags, fmt, __VA_ARGS__)
+    #define LOG_ASYNC_EVERY_ID_C(id, n, tags, fmt, ...) if (::Logging::IsLoggibleEveryID<n>(id, LOG_ASYNC_EVERY_ID_ANCHOR())) LOG_ASYNC_C(tags, fmt, __VA_ARGS__)
+
+#else //This supports GCC, I don't know what format Clang would require for this.
+
+    #define LOG_ASYNC_C(tags, fmt, ...) if (const LogSite* LOG_ASYNC_SITE_ = ::Logging::LoggableSite(LOG_ASYNC_SITE_LIST(tags))) ::Logging::HandlePrintfStyle(*LOG_ASYNC_SITE_, fmt, ##__VA_ARGS__)
+    #define LOG_ASYNC_IF_C(expr, tags, fmt, ...) if (expr) LOG_ASYNC_C(tags, fmt, ##__VA_ARGS__)
+    #define LOG_ASYNC_EVERY_C(n, tags, fmt, ...) if (::Logging::IsLoggableEvery<n>(LOG_ASYNC_EVERY_COUNTER())) LOG_ASYNC_C(tags, fmt, ##__VA_ARGS__)
+    #define LOG_ASYNC_EVERY_ID_C(id, n, tags, fmt, ...) if (::Logging::IsLoggibleEveryID<n>(id, LOG_ASYNC_EVERY_ID_ANCHOR())) LOG_ASYNC_C(tags, fmt, ##__VA_ARGS__)
+
+#endif
+
+
+namespace Logging
+{
+    // --------------------------------------------------------------------------------------------
+    // Add a log that will process through the input data we have.
+    // --------------------------------------------------------------------------------------------
+    std::shared_ptr<RotatedLog> RegisterLog(const std::string& filename);
+    std::shared_ptr<RotatedLog> RegisterSizeRotatedLog(const std::string& filename, const uint64_t maxBytes, const unsigned numToRotateThrough);
+    std::shared_ptr<RotatedLog> RegisterPeriodRotatedLog(const std::string& filename, const uint64_t secondsPerLog, const unsigned numToRotateThrough);
+    std::shared_ptr<RotatedLog> RegisterDailyLog(const std::string& filename, const unsigned hour, const unsigned minute, const unsigned second);
+    
+    std::shared_ptr<NetworkIO::LogSocket> RegisterUDPv4_Destination(const std::string& ip, const std::string& port);
+    std::shared_ptr<NetworkIO::LogSocket> RegisterUDPv6_Destination(const std::string& ip, const std::string& port);
+
+    // --------------------------------------------------------------------------------------------
+    // Do we even need to log anything?
+    // If we don't have anything that needs to be logged, there's no sense in even trying to
+    // queue/dequeue logs that won't even be logged...
+    //
+    // LoggableSite returns the input site if it's loggable, and nullptr otherwise - it lets the
+    // LOG_ASYNC macros keep a reference to the line's static site inside an if statement.
+    // --------------------------------------------------------------------------------------------
+    bool IsLoggable(const LogSite& site);
+    inline const LogSite* LoggableSite(const LogSite& site) { return IsLoggable(site) ? &site : nullptr; }
+
+    // --------------------------------------------------------------------------------------------
+    // Sets up the logging system.  It isn't necessary to call this function, because it's called
+    // by RegisterSocketLog and RegisterRotatedLog functions.
+    // --------------------------------------------------------------------------------------------
+	enum class InitializationMode
+	{
+		PERFECTLY_ORDERED, // Force all queue entries to be time synchronized - this is slower.
+		ALLOW_UNORDERED,   // Ignore the need to perfectly order entries in a queue.
+		NEARLY_ORDERED,    // Enqueue like ALLOW_UNORDERED, but hold records back for a time window and
+		                   // log them in timestamp order.  See SetReorderWindow.
+
+		// TESTING MODES, IGNORE THESE UNLESS YOU NEED TO TEST FORMATTING SPEED OR QUEUE SPEED
+		NO_OP_MODE,        // [Unordered Queue Removal]
+		NO_OP_ORDERED,     // [Queue is sorted by timestamp]
+		NO_OP_NEARLY_ORDERED, // [Queue is held back and sorted within the reorder window]
+	};
+
+    // --------------------------------------------------------------------------------------------
+    // How records get from logging threads to the logging thread.
+    //
+    // SHARED_QUEUE puts every record into one lock free queue that all threads share.
+    //
+    // PER_THREAD_RINGS gives every thread that logs its own fixed size ring, so threads never touch
+    // each other's memory when enqueuing (unless there's a memory limit, whose count of bytes
+    // queued they all update; see SetQueueMemoryLimit).  Each ring costs a few hundred KB per
+    // thread that has ever logged something.  A full ring is handled by the OverflowPolicy, just
+    // like a queue that's reached its memory limit; with the default of BLOCK, the thread waits for
+    // the logging thread to catch up.
+    // With PERFECTLY_ORDERED, records are put in order of their timestamps rather than by a counter
+    // the threads share, so ordering doesn't make threads contend.  Records from one thread keep
+    // their order, but records of different threads with the same timestamp can come out either
+    // way round - which happens a lot with REALTIME_COARSE - and records logged while the system
+    // clock is set back can come out of order with SYSTEM.
+    // --------------------------------------------------------------------------------------------
+	enum class QueueEngine
+	{
+		SHARED_QUEUE,
+		PER_THREAD_RINGS,
+	};
+
+    // --------------------------------------------------------------------------------------------
+    // The clock logging threads timestamp records with.  See LogClock.h for the precision and cost
+    // of each source.  The source is picked once, by the first call to InitLogging; if it isn't
+    // available, the closest one that is gets used instead, and ActiveClockSource reports it.
+    // --------------------------------------------------------------------------------------------
+    void InitLogging(const InitializationMode m = InitializationMode::PERFECTLY_ORDERED,
+                     const QueueEngine e = QueueEngine::SHARED_QUEUE,
+                     const ClockSource c = ClockSource::SYSTEM);
+
+    ClockSource ActiveClockSource();
+
+    // --------------------------------------------------------------------------------------------
+    // The window of NEARLY_ORDERED (20ms by default).  Records are logged in timestamp order as long
+    // as each one is enqueued within the window of records logged after it; one that takes longer
+    // (a logging thread descheduled in the middle of logging, say) is logged as soon as it's
+    // dequeued, out of order.  Every record is delayed by the window, and shutting down waits for it.
+    // --------------------------------------------------------------------------------------------
+    void SetReorderWindow(const milliseconds window);
+
+    // --------------------------------------------------------------------------------------------
+    // The most threads logs and sockets are written from.  By default (or with 0) every log gets a
+    // thread of its own, so a log that's slow to write (a remote socket, say) holds up no other.
+    // With a cap, logs registered once that many threads exist share them, going to whichever has
+    // the fewest, and logs sharing a thread wait on each other.  Either way each log belongs to one
+    // thread, so it still writes records in order.  Logs are never moved, so only logs registered
+    // after the call are affected.
+    // --------------------------------------------------------------------------------------------
+    void SetSinkThreads(const unsigned numThreads);
+
+    // --------------------------------------------------------------------------------------------
+    // Waits until every log and socket has written everything logged before the call, returning
+    // false if that takes longer than the timeout.  With sync, files are also fsync'd before it
+    // returns.  Records that NEARLY_ORDERED is holding back are waited for too, so flushing in that
+    // mode can take up to the reorder window while records are being logged.  Records logged after
+    // the call don't count towards it in any mode.
+    //
+    // It mustn't be called from a log's filter, which runs on the thread the flush waits for.
+    // --------------------------------------------------------------------------------------------
+    bool Flush(const milliseconds timeout = seconds(5), const bool sync = false);
+
+    // --------------------------------------------------------------------------------------------
+    // Caps the memory held by records waiting to be logged, and picks what happens to a record
+    // that would go over the cap.  A limit of 0 (the default) leaves the queue unbounded.
+    //
+    // The memory of a record is estimated as its fixed size plus its payload, so the cap is
+    // approximate, but it can't be exceeded by more than the records already being enqueued.  A
+    // record bigger than the cap is only let in once nothing else is queued.  Records are only
+    // counted while there's a cap, so a cap set later doesn't count what's already queued.  The
+    // count is shared by every thread that logs, so a cap costs PER_THREAD_RINGS some scaling.
+    //
+    // The policy also decides what happens when a PER_THREAD_RINGS ring is full, so it can be set
+    // with a limit of 0 to pick that without a cap.  Dropped records are counted, and every
+    // log/socket writes a "N messages dropped" line the next time it gets records to log.
+    // --------------------------------------------------------------------------------------------
+    enum class OverflowPolicy
+    {
+        BLOCK,          // The logging thread waits until there's room.
+        DROP_NEWEST,    // The record being logged is dropped.
+        DROP_BY_LEVEL,  // Past 7/8 of the cap, records less severe than the keep level are dropped;
+                        // at the cap, everything is dropped.
+        SPIN_THEN_DROP, // The logging thread waits for a bounded time, and drops the record if
+                        // there still isn't room.
+    };
+
+    void SetQueueMemoryLimit(const uint64_t maxBytes, const OverflowPolicy p = OverflowPolicy::BLOCK);
+
+    // The least severe level kept by DROP_BY_LEVEL (LOG_WARNING by default).
+    void SetOverflowKeepLevel(const char* level);
+
+    // How long SPIN_THEN_DROP waits for room (1ms by default).
+    void SetOverflowSpinTime(const microseconds t);
+
+    // Total number of records dropped because the queue was full.
+    uint64_t NumDroppedMessages();
+
+    // --------------------------------------------------------------------------------------------
+    // Sends records at or above level (LOG_ERROR, say) through an express lane, so that they aren't
+    // stuck behind everything else that's queued.  Express records ignore the memory limit, are
+    // handed to the logs before any other queued records, and don't wait on a log that's fallen
+    // behind; they're logged ahead of (and so out of order with) the records queued before
+    // them.  With synchronous, they're written by the thread logging them before the logging call
+    // returns.  That thread then waits on the logs, so it shouldn't log express records from a
+    // log's filter.  A null level turns the express lane off, which is the default.
+    // --------------------------------------------------------------------------------------------
+    void SetExpressLevel(const char* level, const bool synchronous = false);
+
+    // --------------------------------------------------------------------------------------------
+    // Logging from many processes through one.  The collector process calls InitLogging, registers
+    // its logs and sockets, and then StartCollector, which creates a shared memory queue with the
+    // given name (a POSIX shared memory name, "/my_service_logs" say).  Other processes call
+    // AttachToSharedQueue instead of InitLogging; from then on, everything they log goes to the
+    // collector's logs, with the collector's formatting.  They don't run a logging thread or open
+    // any files of their own.
+    //
+    // Each attached process gets a lane of laneBytes bytes (rounded up to a power of 2), and at most
+    // numLanes processes can be attached at once; lanes of processes that have exited are reused.
+    // A process that forks gets a new lane for the child the first time the child logs.  Records
+    // that don't fit in a full lane within a millisecond, or that would take up more than a quarter
+    // of one, are dropped rather than holding the process up, and the collector logs how many were.
+    // Logging levels are still set by each process for itself, while Flush and the memory limit
+    // only apply to the collector.  A lane holding a record that doesn't make sense (its process
+    // scribbled on it, say) is skipped, with an error on cerr.
+    //
+    // The collector checks the lanes every millisecond when they're empty, so records take up to
+    // that long to arrive.  StopCollector (and ShutdownLogging) log what's still in the lanes and
+    // remove the queue.  Only available on platforms with POSIX shared memory.
+    // --------------------------------------------------------------------------------------------
+    bool StartCollector(const std::string& name, const unsigned numLanes = 64, const uint64_t laneBytes = 1 << 20);
+    void StopCollector();
+    bool AttachToSharedQueue(const std::string& name);
+
+    // --------------------------------------------------------------------------------------------
+    // Where streamed and printf style arguments are converted into text.
+    //
+    // DEFERRED copies the raw arguments (plus a pointer to the printf format string) into the
+    // queue and leaves the text conversion to the logging thread, so a logging call costs a copy
+    // rather than integer and float formatting.  The output is the same in either mode.
+    //
+    // !!! WARNING !!!  In DEFERRED mode, the format strings given to LOG_ASYNC_C are referenced
+    //                  after the call returns, so they must be string literals (or otherwise live
+    //                  for as long as the logging system does).
+    //
+    // The mode can be switched at any time; it's applied per logged line.
+    // --------------------------------------------------------------------------------------------
+    enum class FormattingMode
+    {
+        IMMEDIATE, // Format on the calling thread (default).
+        DEFERRED,  // Format on the logging thread.
+    };
+
+    void SetFormattingMode(const FormattingMode m);
+    bool IsFormattingDeferred();
+
+    // --------------------------------------------------------------------------------------------
+    // It is not necessary to call this function, but doing so ensures that any outstanding messages
+    // that have yet to be logged will be logged before the system is shut down.
+    // --------------------------------------------------------------------------------------------
+    void ShutdownLogging();
+
+    // --------------------------------------------------------------------------------------------
+    // Logs a certain line only x number of times.  Each time this block of code is hit, the
+    // repetition count increases by 1.  This rolls around over a uint_fast32_t, which has a 
+    // side effect of causing a log to be logged even if it hasn't reached n iterations.
+    //
+    // Assumptions:  Each line of code contains AT MOST ONE reference to this function (i.e.
+    //               keep each log on a separate line or else we can't track the entries properly).
+    //
+    // Each LOG_ASYNC_EVERY line keeps its count in its own LineCounter, which is padded out to a
+    // cache line so that busy lines don't slow each other down.  Its constructor is constexpr, so
+    // the counter is set up at compile time and there's no guard to check when it's used.
+    // --------------------------------------------------------------------------------------------
+    struct alignas(LOG_CACHE_LINE_SIZE) LineCounter
+    {
+        std::atomic<uint_fast32_t> _count;
+        constexpr LineCounter() : _count(0) {}
+    };
+
+    inline uint_fast32_t NumInstancesEvery(LineCounter& counter)
+    {
+        return counter._count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // --------------------------------------------------------------------------------------------
+    // Counts for LOG_ASYNC_EVERY_ID are kept per (line, id) pair in a fixed size, lock free table,
+    // so memory stays the same no matter how many distinct ids (user ids, connection ids, ...)
+    // are logged.  Counts roll over at 2^24 rather than at 2^32.
+    // --------------------------------------------------------------------------------------------
+    uint_fast32_t NumInstancesEveryID(const uint64_t id, const void* lineAnchor);
+
+    template<unsigned LOG_FREQUENCY> inline bool IsLoggableEvery(LineCounter& counter)
+    {
+        return NumInstancesEvery(counter) % LOG_FREQUENCY == 0;
+    }
+
+    template<unsigned LOG_FREQUENCY> inline bool IsLoggibleEveryID(const uint64_t id, const void* lineAnchor)
+    {
+        return NumInstancesEveryID(id, lineAnchor) % LOG_FREQUENCY == 0;
+    }
+
+    // --------------------------------------------------------------------------------------------
+    // Rate limiting for LOG_ASYNC_RATE.
+    //
+    // Each line keeps a RateLimiter, which is a token bucket kept as a single "theoretical arrival
+    // time" (GCRA): a line is let through if doing so doesn't push that time more than burst
+    // intervals past now.  Checking it costs a coarse clock read and a compare-exchange.
+    //
+    // The clock only ticks every few milliseconds on Linux, so burst should be at least
+    // perSecond * 0.004 for the average rate to come out right at high rates.  A rate of 0 (or
+    // less) holds every line back.
+    // --------------------------------------------------------------------------------------------
+    struct alignas(LOG_CACHE_LINE_SIZE) RateLimiter
+    {
+        std::atomic<int64_t> _theoreticalArrival; // Nanoseconds, CoarseMonotonicNanoseconds based.
+        std::atomic<uint64_t> _suppressed;        // Lines held back since the last one let through.
+        constexpr RateLimiter() : _theoreticalArrival(0), _suppressed(0) {}
+    };
+
+    // Returns the limiter if the line can be logged, and nullptr if it's held back.
+    inline RateLimiter* PassesRateLimit(RateLimiter& limiter, const double perSecond, const double burst)
+    {
+        if (!(perSecond > 0.0))
+        {
+            limiter._suppressed.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        const int64_t now = CoarseMonotonicNanoseconds();
+        const int64_t interval = static_cast<int64_t>(1e9 / perSecond);
+        const int64_t tolerance = static_cast<int64_t>(interval * (burst < 1.0 ? 1.0 : burst));
+
+        int64_t arrival = limiter._theoreticalArrival.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            const int64_t from = arrival > now ? arrival : now;
+            if (from + interval - now > tolerance)
+            {
+                limiter._suppressed.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            if (limiter._theoreticalArrival.compare_exchange_weak(arrival, from + interval, std::memory_order_relaxed)) { return &limiter; }
+        }
+    }
+
+    // "[N suppressed] " if lines were held back since the last one was logged, or nothing.
+    inline std::string TakeSuppressedNote(RateLimiter& limiter)
+    {
+        if (limiter._suppressed.load(std::memory_order_relaxed) == 0) { return std::string(); }
+
+        const uint64_t numSuppressed = limiter._suppressed.exchange(0, std::memory_order_relaxed);
+        return numSuppressed == 0 ? std::string() : "[" + std::to_string(numSuppressed) + " suppressed] ";
+    }
+
+    // --------------------------------------------------------------------------------------------
+    // LoggingStream is the streamable interface that the LOG_ASYNC macros return.
+    //
+    // std::endl is a termination flag that indicates that the streamed content should be
+    // sent to the logging system; any lines not containing this flag will not behave as intended.
+    // --------------------------------------------------------------------------------------------
+    class LoggingStream
+    {
+    private:
+		fmt::MemoryWriter _w;
+        const LogSite* _site;
+
+        // Raw arguments, used instead of _w when formatting is deferred for the current line.
+        bool _deferArguments;
+        std::string _arguments;
+        typedef std::basic_ostream<char, std::char_traits<char> > CoutType;
+        typedef CoutType& (*StandardEndLine)(CoutType&);
+
+    public:
+        LoggingStream();
+        ~LoggingStream();
+
+        // --------------------------------------------------------------------------------------------
+        // Configure parts of the stream that the logging system will need to log later on.
+		// These don't need to be called by users of the logging system.
+        // --------------------------------------------------------------------------------------------
+        void SetSite(const LogSite& site);
+
+		// --------------------------------------------------------------------------------------------
+		// Handle the input data we're actually logging.
+		// Since std::endl acts as a logging terminator, it needs to be handled individually.
+		// --------------------------------------------------------------------------------------------
+
+        LoggingStream& operator<<(StandardEndLine c);
+        template <class T> LoggingStream& operator<<(const T& o)
+        {
+            if (_deferArguments) { AppendArgument(_arguments, o); }
+            else                 { _w << o; }
+            return *this;
+        }
+
+    };
+
+    // --------------------------------------------------------------------------------------------
+    // Helper method called by LOG_ASYNC macros to obtain a thread-local LoggingStream.
+    // --------------------------------------------------------------------------------------------
+    LoggingStream& GetLogStream(const LogSite& site);
+
+    // --------------------------------------------------------------------------------------------
+    // FieldBuilder collects the fields given to LOG_ASYNC_KV, and logs them when it's destroyed at
+    // the end of the statement.
+    //
+    // Numbers and bools are copied as they are rather than being converted to text, so logging
+    // fields costs about as much as copying them.  Strings are copied; anything else is formatted
+    // with its operator<< and kept as a string.  Sinks write the fields out as text, logfmt or JSON
+    // (LogBase::SetFieldFormat), and filters can look at them with LogData::FindField.
+    // --------------------------------------------------------------------------------------------
+    void LogFields(const LogSite& site, std::string&& fields);
+
+    class FieldBuilder
+    {
+    private:
+        const LogSite* _site;
+        std::string _fields;
+
+    public:
+        explicit FieldBuilder(const LogSite& site) : _site(&site), _fields(AcquireLogBuffer()) {}
+        FieldBuilder(const FieldBuilder&) = delete;
+        FieldBuilder& operator=(const FieldBuilder&) = delete;
+        ~FieldBuilder() { LogFields(*_site, std::move(_fields)); }
+
+        template <class T> FieldBuilder& operator()(const char* key, const T& value)
+        {
+            AppendField(_fields, key, value);
+            return *this;
+        }
+    };
+
+	// --------------------------------------------------------------------------------------------
+	// Methods called by the prinf style logging stuff.
+	// --------------------------------------------------------------------------------------------
+	void LogPrintfStyle(const LogSite& site, std::string&& logWhat);
+	void LogPrintfStyleDeferred(const LogSite& site, const char* format, std::string&& encodedArgs);
+
+	template <class ...Args>
+	inline void HandlePrintfStyle(const LogSite& site, const char* format, Args&& ...args)
+	{
+		if (IsFormattingDeferred())
+		{
+			std::string encodedArgs = AcquireLogBuffer();
+			AppendArguments(encodedArgs, args...);
+			LogPrintfStyleDeferred(site, format, std::move(encodedArgs));
+		}
+		else { LogPrintfStyle(site, fmt::sprintf(format, std::forward<Args>(args)...)); }
+	}
+	inline void HandlePrintfStyleEmpty(const LogSite& site, const char* format)
+	{
+		LogPrintfStyle(site, format);
+	}
+
+    void SetLoggingLevel(const char* level);
+
+	// --------------------------------------------------------------------------------------------
+	// Ignore logging if the disk space is above a certain percentage.
+	// - 0.0 means no logging will occur (will stop logging at 0% full)
+	// - 100.0 means log until disk space is full.
+	// - New logs are ENTIRELY IGNORED if the disk space criteria is met.
+	// --------------------------------------------------------------------------------------------
+	
+	void SetDiskSpaceThreshold(const double percentage);
 }
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include <atomic>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "LogClock.h"
+
+#ifdef LOG_HAS_TSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+constexpr unsigned CLOCK_SAMPLE_ATTEMPTS = 5;          // Reads per calibration sample; the tightest one is kept.
+constexpr milliseconds TSC_INITIAL_CALIBRATION(10);    // How long SetClockSource measures the TSC rate for.
+constexpr double CLOCK_MAX_RATE_CHANGE = 0.01;         // A bigger change between calibrations means the wall clock was set.
+
+namespace
+{
+	// Only the thread holding calibrationLock changes the calibration.  Each change is then
+	// published to the atomics below under a sequence count (odd while a change is being
+	// published), so CurrentClockCalibration can copy it out without taking the lock, and
+	// retries if a change lands while it's copying.
+	std::mutex calibrationLock;
+	ClockCalibration calibration = {ClockSource::SYSTEM, 0, 0, 1.0};
+
+	std::atomic<uint32_t> publishedSequence(0);
+	std::atomic<ClockSource> publishedSource(ClockSource::SYSTEM);
+	std::atomic<int64_t> publishedBaseTicks(0);
+	std::atomic<int64_t> publishedBaseNanoseconds(0);
+	std::atomic<double> publishedNanosecondsPerTick(1.0);
+	std::atomic<int64_t> lastCalibratedAt(0); // CoarseMonotonicNanoseconds
+
+	int64_t WallNanoseconds()
+	{
+		return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+	}
+
+	bool HasInvariantTSC()
+	{
+#if defined(LOG_HAS_TSC) && defined(_MSC_VER)
+		int regs[4] = {0, 0, 0, 0};
+		__cpuid(regs, 0x80000000);
+		if (static_cast<unsigned>(regs[0]) < 0x80000007) { return false; }
+		__cpuid(regs, 0x80000007);
+		return (regs[3] & (1 << 8)) != 0;
+#elif defined(LOG_HAS_TSC)
+		unsigned eax = 0, ebx = 0, ecx = 0, edx = 0;
+		if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)) { return false; }
+		return (edx & (1 << 8)) != 0;
+#else
+		return false;
+#endif
+	}
+
+	// ---------------------------------------------------------------------------
+	// Reads the source on either side of the wall clock, and pairs the wall clock
+	// with the midpoint of the tightest pair of reads.
+	// ---------------------------------------------------------------------------
+	void SampleClock(int64_t& ticks, int64_t& wallNanoseconds)
+	{
+		int64_t narrowest = std::numeric_limits<int64_t>::max();
+		for (unsigned i = 0; i < CLOCK_SAMPLE_ATTEMPTS; ++i)
+		{
+			const int64_t before = ReadClockTicks();
+			const int64_t wall = WallNanoseconds();
+			const int64_t after = ReadClockTicks();
+
+			if (after - before < narrowest)
+			{
+				narrowest = after - before;
+				ticks = before + (after - before) / 2;
+				wallNanoseconds = wall;
+			}
+		}
+	}
+
+	// ---------------------------------------------------------------------------
+	// Makes the calibration visible to CurrentClockCalibration.  Assumes
+	// calibrationLock is held.
+	// ---------------------------------------------------------------------------
+	void PublishCalibration()
+	{
+		const uint32_t sequence = publishedSequence.load(std::memory_order_relaxed);
+		publishedSequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		publishedSource.store(calibration._source, std::memory_order_relaxed);
+		publishedBaseTicks.store(calibration._baseTicks, std::memory_order_relaxed);
+		publishedBaseNanoseconds.store(calibration._baseNanoseconds, std::memory_order_relaxed);
+		publishedNanosecondsPerTick.store(calibration._nanosecondsPerTick, std::memory_order_relaxed);
+
+		publishedSequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	// ---------------------------------------------------------------------------
+	// Moves the calibration point to now, taking the rate measured since the last
+	// point.  Assumes calibrationLock is held.
+	// ---------------------------------------------------------------------------
+	void Recalibrate()
+	{
+		int64_t ticks = 0, wallNanoseconds = 0;
+		SampleClock(ticks, wallNanoseconds);
+
+		if (ticks > calibration._baseTicks && wallNanoseconds - calibration._baseNanoseconds >= LOG_CLOCK_CALIBRATION_INTERVAL.count() / 2)
+		{
+			const double rate = static_cast<double>(wallNanoseconds - calibration._baseNanoseconds) / static_cast<double>(ticks - calibration._baseTicks);
+			if (std::fabs(rate / calibration._nanosecondsPerTick - 1.0) <= CLOCK_MAX_RATE_CHANGE) { calibration._nanosecondsPerTick = rate; }
+		}
+
+		calibration._baseTicks = ticks;
+		calibration._baseNanoseconds = wallNanoseconds;
+		PublishCalibration();
+		lastCalibratedAt.store(CoarseMonotonicNanoseconds(), std::memory_order_relaxed);
+	}
+}
+
+ClockSource SetClockSource(const ClockSource s)
+{
+	ClockSource used = s;
+
+	if (used == ClockSource::TSC && !HasInvariantTSC())
+	{
+		std::cerr << "WARNING - This CPU doesn't have an invariant TSC; using " << ClockSourceName(ClockSource::MONOTONIC_RAW) << " for timestamps instead." << std::endl;
+		used = ClockSource::MONOTONIC_RAW;
+	}
+#ifndef CLOCK_MONOTONIC_RAW
+	if (used == ClockSource::MONOTONIC_RAW) { used = ClockSource::SYSTEM; }
+#endif
+#ifndef CLOCK_REALTIME_COARSE
+	if (used == ClockSource::REALTIME_COARSE) { used = ClockSource::SYSTEM; }
+#endif
+	if (used == ClockSource::SYSTEM && s != ClockSource::SYSTEM)
+	{
+		std::cerr << "WARNING - " << ClockSourceName(s) << " isn't available on this platform; using " << ClockSourceName(used) << " for timestamps instead." << std::endl;
+	}
+
+	std::lock_guard<std::mutex> lock(calibrationLock);
+	ActiveClockSourceRef().store(used, std::memory_order_relaxed);
+	calibration = {used, 0, 0, 1.0};
+
+	if (used == ClockSource::TSC || used == ClockSource::MONOTONIC_RAW)
+	{
+		SampleClock(calibration._baseTicks, calibration._baseNanoseconds);
+	}
+	if (used == ClockSource::TSC)
+	{
+		// Measure a first rate; the logging thread refines it as it recalibrates.
+		std::this_thread::sleep_for(TSC_INITIAL_CALIBRATION);
+
+		int64_t ticks = 0, wallNanoseconds = 0;
+		SampleClock(ticks, wallNanoseconds);
+		calibration._nanosecondsPerTick = static_cast<double>(wallNanoseconds - calibration._baseNanoseconds) / static_cast<double>(ticks - calibration._baseTicks);
+		calibration._baseTicks = ticks;
+		calibration._baseNanoseconds = wallNanoseconds;
+	}
+
+	PublishCalibration();
+	lastCalibratedAt.store(CoarseMonotonicNanoseconds(), std::memory_order_relaxed);
+	return used;
+}
+
+ClockCalibration CurrentClockCalibration()
+{
+	// Whoever finds the calibration stale first refreshes it; anyone else that finds it stale
+	// meanwhile carries on with the one before, which is still within the clock's drift.
+	const ClockSource source = publishedSource.load(std::memory_order_relaxed);
+	const bool calibrated = source == ClockSource::TSC || source == ClockSource::MONOTONIC_RAW;
+	if (calibrated && CoarseMonotonicNanoseconds() - lastCalibratedAt.load(std::memory_order_relaxed) >= LOG_CLOCK_CALIBRATION_INTERVAL.count())
+	{
+		std::unique_lock<std::mutex> lock(calibrationLock, std::try_to_lock);
+		if (lock.owns_lock() && CoarseMonotonicNanoseconds() - lastCalibratedAt.load(std::memory_order_relaxed) >= LOG_CLOCK_CALIBRATION_INTERVAL.count()) { Recalibrate(); }
+	}
+
+	ClockCalibration c;
+	uint32_t sequence = 0;
+	do
+	{
+		sequence = publishedSequence.load(std::memory_order_acquire);
+		c._source = publishedSource.load(std::memory_order_relaxed);
+		c._baseTicks = publishedBaseTicks.load(std::memory_order_relaxed);
+		c._baseNanoseconds = publishedBaseNanoseconds.load(std::memory_order_relaxed);
+		c._nanosecondsPerTick = publishedNanosecondsPerTick.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+	} while ((sequence & 1) != 0 || publishedSequence.load(std::memory_order_relaxed) != sequence);
+
+	return c;
+}
+
+const char* ClockSourceName(const ClockSource s)
+{
+	switch (s)
+	{
+		case ClockSource::REALTIME_COARSE: { return "CLOCK_REALTIME_COARSE"; }
+		case ClockSource::MONOTONIC_RAW:   { return "CLOCK_MONOTONIC_RAW"; }
+		case ClockSource::TSC:             { return "TSC"; }
+		case ClockSource::SYSTEM:
+		default:                           { return "system_clock"; }
+	}
+}
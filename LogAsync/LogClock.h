@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <time.h>
+
+#include "TimeManip.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define LOG_HAS_TSC 1
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// ------------------------------------------------------------------------------------
+// Where logging threads get the timestamp of a record from.
+//
+// Logging threads only read the raw value of the clock; the logging thread converts it to
+// wall clock time before any log sees the record, so every source produces the same
+// system_clock timestamps for filters and %t.
+//
+// - SYSTEM:          system_clock::now().  Nanosecond resolution and always in step with
+//                    the wall clock.  This is the default.
+//
+// - REALTIME_COARSE: CLOCK_REALTIME_COARSE.  The cheapest read, but it only advances once per
+//                    kernel tick (1-4ms), so records logged close together share a timestamp.
+//
+// - MONOTONIC_RAW:   CLOCK_MONOTONIC_RAW.  Nanosecond resolution and never adjusted by NTP,
+//                    so the spacing between records is exact.  Wall time comes from a
+//                    calibration refreshed every LOG_CLOCK_CALIBRATION_INTERVAL, and is within
+//                    the clock's drift over that interval (a few microseconds).
+//
+// - TSC:             the CPU's timestamp counter (rdtsc).  The cheapest high resolution read,
+//                    calibrated like MONOTONIC_RAW.  It's only used on x86 CPUs with an
+//                    invariant TSC; anywhere else MONOTONIC_RAW is used instead.
+//
+// Sources that aren't available on a platform fall back to SYSTEM, with a message to cerr.
+// ------------------------------------------------------------------------------------
+enum class ClockSource : uint8_t
+{
+	SYSTEM,
+	REALTIME_COARSE,
+	MONOTONIC_RAW,
+	TSC,
+};
+
+constexpr nanoseconds LOG_CLOCK_CALIBRATION_INTERVAL = seconds(1);
+
+// The active source.  Constant initialized, so reading it is just a load.
+inline std::atomic<ClockSource>& ActiveClockSourceRef()
+{
+	static std::atomic<ClockSource> source(ClockSource::SYSTEM);
+	return source;
+}
+
+#if defined(CLOCK_REALTIME_COARSE) || defined(CLOCK_MONOTONIC_RAW)
+inline int64_t ReadClockNanoseconds(const clockid_t id)
+{
+	timespec ts;
+	clock_gettime(id, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+// --------------------------------------------------------------------------------------------
+// Raw reading of the active source, as stored in LogData::_clockTicks.
+// --------------------------------------------------------------------------------------------
+inline int64_t ReadClockTicks()
+{
+	switch (ActiveClockSourceRef().load(std::memory_order_relaxed))
+	{
+#ifdef LOG_HAS_TSC
+		case ClockSource::TSC:             { return static_cast<int64_t>(__rdtsc()); }
+#endif
+#ifdef CLOCK_REALTIME_COARSE
+		case ClockSource::REALTIME_COARSE: { return ReadClockNanoseconds(CLOCK_REALTIME_COARSE); }
+#endif
+#ifdef CLOCK_MONOTONIC_RAW
+		case ClockSource::MONOTONIC_RAW:   { return ReadClockNanoseconds(CLOCK_MONOTONIC_RAW); }
+#endif
+		case ClockSource::SYSTEM:
+		default:                           { return duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count(); }
+	}
+}
+
+// --------------------------------------------------------------------------------------------
+// Converts ticks of a source to wall clock time.  SYSTEM and REALTIME_COARSE ticks already are
+// nanoseconds since the epoch; the others are mapped through the last calibration point.
+// --------------------------------------------------------------------------------------------
+struct ClockCalibration
+{
+	ClockSource _source;
+	int64_t _baseTicks;
+	int64_t _baseNanoseconds;
+	double _nanosecondsPerTick;
+
+	system_clock::time_point ToTimePoint(const int64_t ticks) const
+	{
+		int64_t ns = ticks;
+		if (_source == ClockSource::MONOTONIC_RAW || _source == ClockSource::TSC)
+		{
+			ns = _baseNanoseconds + static_cast<int64_t>(static_cast<double>(ticks - _baseTicks) * _nanosecondsPerTick);
+		}
+		return system_clock::time_point(duration_cast<system_clock::duration>(nanoseconds(ns)));
+	}
+
+	// How many ticks of the source a span of time is.
+	int64_t ToTicks(const nanoseconds span) const
+	{
+		if (_source == ClockSource::MONOTONIC_RAW || _source == ClockSource::TSC)
+		{
+			return static_cast<int64_t>(static_cast<double>(span.count()) / _nanosecondsPerTick);
+		}
+		return span.count();
+	}
+
+	// The reverse of ToTimePoint: what the source read at a wall clock time.
+	int64_t TicksAt(const int64_t wallNanoseconds) const
+	{
+		if (_source == ClockSource::MONOTONIC_RAW || _source == ClockSource::TSC)
+		{
+			return _baseTicks + static_cast<int64_t>(static_cast<double>(wallNanoseconds - _baseNanoseconds) / _nanosecondsPerTick);
+		}
+		return wallNanoseconds;
+	}
+};
+
+// --------------------------------------------------------------------------------------------
+// Makes s the active source (or the closest available one), returning the source in use.
+// Records already logged with a different source will get wrong timestamps, so this should
+// only be called before anything is logged (InitLogging does).
+// --------------------------------------------------------------------------------------------
+ClockSource SetClockSource(const ClockSource s);
+
+// The calibration to convert ticks with, refreshed if it's stale.  It doesn't wait on a lock, so
+// logging threads converting synchronous express records can call it as well as the logging thread.
+ClockCalibration CurrentClockCalibration();
+
+const char* ClockSourceName(const ClockSource s);
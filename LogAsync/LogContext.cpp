@@ -0,0 +1,33 @@
+#include "LogContext.h"
+
+namespace
+{
+	thread_local std::shared_ptr<const LogContext> currentContext;
+}
+
+const std::shared_ptr<const LogContext>& CurrentLogContext()
+{
+	return currentContext;
+}
+
+namespace Logging
+{
+	// ---------------------------------------------------------------------------
+	// The new snapshot is the new fields followed by everything already in scope,
+	// so lookups find the innermost fields first.
+	// ---------------------------------------------------------------------------
+	void ScopedContext::Push(std::string&& fields)
+	{
+		_previous = currentContext;
+		if (_previous) { fields += _previous->_fields; }
+
+		auto context = std::make_shared<LogContext>();
+		context->_fields = std::move(fields);
+		currentContext = std::move(context);
+	}
+
+	ScopedContext::~ScopedContext()
+	{
+		currentContext = std::move(_previous);
+	}
+}
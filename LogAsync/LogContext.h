@@ -0,0 +1,69 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "LogArguments.h"
+
+// ------------------------------------------------------------------------------------
+// Context fields of a thread (request ids, tenants, ...) that every record it logs carries.
+//
+// A LogContext is an immutable snapshot of all the fields in scope, encoded like the fields
+// of LOG_ASYNC_KV.  Records share the snapshot through a shared_ptr rather than copying it,
+// so logging inside a context costs a reference count increment.
+// ------------------------------------------------------------------------------------
+struct LogContext
+{
+	std::string _fields;
+};
+
+// The snapshot records logged by this thread right now get, or nullptr if there isn't one.
+const std::shared_ptr<const LogContext>& CurrentLogContext();
+
+namespace Logging
+{
+	// --------------------------------------------------------------------------------------------
+	// Adds fields to the context of the calling thread for as long as it's in scope:
+	//
+	//     Logging::ScopedContext context("request_id", id, "tenant", tenant);
+	//
+	// Fields take any value LOG_ASYNC_KV does, and keys must be string literals.  Scopes nest, with
+	// the innermost fields first; a key shouldn't be repeated by an inner scope, as both values
+	// would be written.  Logs write the fields with %C (see LoggingFormat), and filters can look
+	// at them with LogData::FindContext.
+	//
+	// A ScopedContext has to be destroyed by the thread that created it, in reverse order of
+	// creation, which is what happens to local variables anyway.
+	// --------------------------------------------------------------------------------------------
+	class ScopedContext
+	{
+	private:
+		std::shared_ptr<const LogContext> _previous;
+
+		void Push(std::string&& fields);
+
+		inline void AppendContextFields(std::string& out) {}
+
+		template <class T, class ...Args>
+		inline void AppendContextFields(std::string& out, const char* key, const T& value, const Args& ...args)
+		{
+			AppendField(out, key, value);
+			AppendContextFields(out, args...);
+		}
+
+	public:
+		template <class ...Args>
+		explicit ScopedContext(const char* key, const Args& ...keysAndValues) : _previous()
+		{
+			static_assert(sizeof...(Args) % 2 == 1, "ScopedContext takes key/value pairs");
+
+			std::string fields;
+			AppendContextFields(fields, key, keysAndValues...);
+			Push(std::move(fields));
+		}
+
+		ScopedContext(const ScopedContext&) = delete;
+		ScopedContext& operator=(const ScopedContext&) = delete;
+		~ScopedContext();
+	};
+}
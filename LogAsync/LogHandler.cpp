@@ -1,508 +1,765 @@
-#include <boost/lexical_cast.hpp>
-#include <boost/filesystem.hpp>
-
-#include "LogHandler.h"
-
-constexpr milliseconds DEFAULT_DISK_CHECK_INTERVAL = milliseconds(5000);
-constexpr size_t BUFFER_SIZE = 4096;
-
-// ---------------------------------------------------------------------------------
-// Implementation for LogBase
-// ---------------------------------------------------------------------------------
-LogBase::LogBase() :
-	_filterLock(),
-	_configLock(),
-	_useCache(true),
-	_localQuitLogging(false),
-    _config(),
-    _inputFilters(),
-	_sourceEvalCache()
-{}
-
-LogBase::~LogBase() 
-{
-    _localQuitLogging = true;
-}
-
-void LogBase::DisableCache() 
-{
-	std::lock_guard<std::mutex> lock(_filterLock);
-	_sourceEvalCache.clear();
-	_useCache = false; 
-}
-void LogBase::EnableCache() 
-{
-	std::lock_guard<std::mutex> lock(_filterLock);
-	_useCache = true; 
-}
-
-// ---------------------------------------------------------------------------------
-// ASSUMES THAT WE HAVE A LOCK ACQUIRED.  This does not lock for performance reasons,
-// and assumes that nothing will modify _inputFilters or _sourceEvalCache!
-// ---------------------------------------------------------------------------------
-bool LogBase::MeetsLoggingCriteria(const LogData& l)
-{
-	// Don't even lookup matches if we know everything's going to be logged.
-	if (_inputFilters.empty()) { return true; }
-
-	// Check and see if the value is cached already.
-	auto cachePos = _sourceEvalCache.find(l._codeSrc);
-	if (cachePos == _sourceEvalCache.end())
-	{
-		for (auto & filter : _inputFilters)
-		{
-			if (filter(l)) 
-			{
-				// Cache the value we've added since now that
-				// we know the line matches the criteria.
-				if (_useCache) { _sourceEvalCache[l._codeSrc] = true; }
-				return true;
-			}
-		}
-
-		// No match, this line is false in the cache.
-		if (_useCache) { _sourceEvalCache[l._codeSrc] = false; }
-		return false;
-	}
-
-	// Return the cached value.
-	return cachePos->second;
-}
-
-// ---------------------------------------------------------------------------------
-// Clears source cache because we're adding new filters that might affect the
-// result, and adds the new filter to the input list.
-// ---------------------------------------------------------------------------------
-void LogBase::AddInputFilter(FilterType&& func)
-{
-    std::lock_guard<std::mutex> lock(_filterLock);
-    _inputFilters.emplace_back(func);
-	_sourceEvalCache.clear();
-}
-
-// ---------------------------------------------------------------------------------
-// Clears source cache because we're adding new filters that might affect the
-// result, and adds the new filter to the input list.
-// ---------------------------------------------------------------------------------
-void LogBase::AddExclusiveInputFilter(FilterType&& func)
-{
-    ClearAllFilters();
-    AddInputFilter(std::move(func));
-	_sourceEvalCache.clear();
-}
-
-// ---------------------------------------------------------------------------------
-// Clears source cache because we're removing all filters.
-// ---------------------------------------------------------------------------------
-void LogBase::ClearAllFilters()
-{
-    std::lock_guard<std::mutex> lock(_filterLock);
-    _inputFilters.clear();
-	_sourceEvalCache.clear();
-}
-
-void LogBase::SetConfiguration(const std::string& logformat, const std::string& dateformat)
-{
-    std::lock_guard<std::mutex> lock(_configLock);
-	_config.SetLogFormat(logformat, dateformat);
-}
-
-// ---------------------------------------------------------------------------------
-// Implementation for RotatedLog
-// ---------------------------------------------------------------------------------
-RotatedLog::RotatedLog(const std::string& baseName) :
-	LogBase(),
-
-	_activeFileSize(0),
-	_filename(baseName),
-
-	_diskIsFull(false),
-	_diskThreshold(100.0),
-
-	_lastCheckedDiskSpace(system_clock::now()),
-
-	_rotationType(ROTATION_METHOD::NO_ROTATION),
-	_maxFilesizeBytes(0),
-
-	_rotateIntervalSeconds(0),
-	_numToRotateThrough(0),
-
-	_rotationHMS({0,0,0}),
-	_lastRotatedAt(system_clock::now()),
-	_diskCheckInterval(DEFAULT_DISK_CHECK_INTERVAL),
-
-    _monitorRotation(),
-
-	_logBuffer()
-{
-    if (_filename.empty())
-    {
-        _filename = "Unknown." + boost::lexical_cast<std::string>(time(0)) + ".log";
-    }
-
-	CheckDiskSpace();
-}
-
-RotatedLog::~RotatedLog() 
-{
-    _localQuitLogging = true;
-}
-
-void RotatedLog::RenameExistingLogs() const
-{
-    auto pathOfFile = boost::filesystem::path(_filename).parent_path();
-    const std::string baseFileName = boost::filesystem::path(_filename).filename().string();
-
-    // We're only keeping track of a max number of logfiles.  If there is an "ending" log already present,
-    // it'll need to be deleted so that we can shift newer logs into its position.
-
-    std::string deletionCandidate = baseFileName + "." + boost::lexical_cast<std::string>(_numToRotateThrough - 1);
-    if (boost::filesystem::exists(pathOfFile / deletionCandidate))
-    {
-        try
-        {
-            boost::filesystem::remove(pathOfFile / deletionCandidate);
-        }
-        catch (const boost::filesystem::filesystem_error& e)
-        {
-            std::cerr << e.what() << std::endl;
-        }
-    }
-
-    // Any filename.n will be renamed to filename.n+1 in reverse order, unless it's the nth entry.
-    // If we're on the inital entry, it will be given a .1 prefix.
-
-    for (int i = _numToRotateThrough - 1; i > 0; --i)
-    {
-        const std::string renameCandidate = baseFileName + "." + boost::lexical_cast<std::string>(i);
-        const std::string renameTo = baseFileName + "." + boost::lexical_cast<std::string>(i + 1);
-        if (boost::filesystem::exists(pathOfFile / renameCandidate))
-        {
-            try
-            {
-                boost::filesystem::rename(pathOfFile / renameCandidate, 
-                                          pathOfFile / renameTo);
-            }
-            catch (const boost::filesystem::filesystem_error& e)
-            {
-                std::cerr << e.what() << std::endl;
-            }
-        }
-    }
-
-    // Rename the base file.  It seems like this throws a lot of false positives when
-    // running through Visual Studio but running it straight as an application has no
-    // problems.  Visual Studio's IDE probably sandboxes around the IOStream methods,
-    // so boost filesystem calls that expect for files to be totally released or unlocked
-    // may not synchronize entirely with the state of the file in the application...
-    try
-    {
-        auto basefile = pathOfFile / baseFileName;
-        auto dotOne = pathOfFile / (baseFileName + ".1");
-
-        if (boost::filesystem::exists(basefile))
-        {
-            boost::filesystem::rename(pathOfFile / baseFileName,
-                                      pathOfFile / (baseFileName + ".1"));
-        }
-    }
-    catch (const boost::filesystem::filesystem_error& e)
-    {
-        std::cerr << e.what() << std::endl;
-    }
-}
-
-
-// ---------------------------------------------------------------------------
-// Close any currently existing log, open a log with the provided name, and
-// update statistics related to loading log files.
-// ---------------------------------------------------------------------------
-void RotatedLog::OpenLog(const std::string& name)
-{
-    _logfile.close();
-    _activeFileSize = 0;
-
-    _logfile.open(name, std::ios::app);
-    _logfile.sync_with_stdio(false);
-
-    _lastRotatedAt = system_clock::now();
-
-    if (!_logfile.is_open())
-    {
-        std::cerr << "ERROR - Unable to open " << name << " for logging!" << std::endl;
-    }
-
-    StatFile(name);
-}
-
-// ---------------------------------------------------------------------------
-// Get the size of a given file.  It's expected to be the file currently in 
-// use by the system, which may differ from the base filename var stored
-// by the class.
-// ---------------------------------------------------------------------------
-void RotatedLog::StatFile(const std::string& filename)
-{
-    try
-    {
-        if (boost::filesystem::exists(filename) && boost::filesystem::is_regular_file(filename))
-        {
-            _activeFileSize = boost::filesystem::file_size(filename);
-        }
-    }
-    catch (const boost::filesystem::filesystem_error& e)
-    {
-        std::cerr << e.what() << std::endl;
-    }
-}
-
-std::string RotatedLog::ConstructLogFileName() const
-{
-    switch (_rotationType)
-    {
-        case RotatedLog::ROTATION_METHOD::ROTATE_AT:
-        {
-            // The TM struct storing the day.
-            tm timeNow = {0};
-
-            const time_t tNow = system_clock::to_time_t(system_clock::now());
-            const time_t tRotated = system_clock::to_time_t(_lastRotatedAt);
-
-            LOCALTIME_FUNC(&tNow, &timeNow);
-
-            timeNow.tm_hour = _rotationHMS[0];
-            timeNow.tm_min  = _rotationHMS[1];
-            timeNow.tm_sec  = _rotationHMS[2];
-
-            time_t switchSeconds = std::mktime(&timeNow);
-
-            // If we've already switched today, use today's date.  Otherwise, we need to subtract a
-            // day because this log is still valid for yesterday - the switch today hasn't occurred!
-
-            if (tNow < switchSeconds) { switchSeconds -= 60 * 60 * 24; }
-
-            tm forFileName = {0};
-            LOCALTIME_FUNC(&switchSeconds, &forFileName);
-            return _filename + "." + TMToStringYMD(forFileName);
-        }
-
-        case RotatedLog::ROTATION_METHOD::NO_ROTATION:
-        case RotatedLog::ROTATION_METHOD::ROTATE_AFTER:
-        case RotatedLog::ROTATION_METHOD::ROTATE_WHEN_SIZE:
-        default:
-        {
-            return _filename;
-        }
-    }
-}
-
-void RotatedLog::HandleRotateAt(const volatile bool& quitEarly)
-{
-    while (!quitEarly && !_localQuitLogging)
-    {
-        const time_t tNow = system_clock::to_time_t(system_clock::now());
-        const time_t tRotated = system_clock::to_time_t(_lastRotatedAt);
-
-        tm switchAt = {0}; 
-        LOCALTIME_FUNC(&tNow, &switchAt);
-
-        switchAt.tm_hour = _rotationHMS[0];
-        switchAt.tm_min  = _rotationHMS[1];
-        switchAt.tm_sec  = _rotationHMS[2];
-
-        const time_t switchSeconds = std::mktime(&switchAt);
-
-        if (tNow <= switchSeconds)
-        {
-            InterruptedSleepUntil(system_clock::from_time_t(switchSeconds), quitEarly);
-        }
-
-        if (quitEarly || _localQuitLogging) { return; }
-
-        std::lock_guard<std::mutex> lock(_fileLock);
-        OpenLog(ConstructLogFileName());
-    }
-}
-
-void RotatedLog::HandleRotateAfter(const volatile bool& quitEarly)
-{
-    while (!quitEarly && !_localQuitLogging)
-    {
-        const auto lastRotated = _lastRotatedAt;
-        const auto rotateWhen = _lastRotatedAt + seconds(_rotateIntervalSeconds);
-
-        InterruptedSleepUntil(rotateWhen, quitEarly);
-        if (quitEarly || _localQuitLogging) { return; }
-
-        // Only rotate the log if the last opened time hasn't changed.
-        // If it has, it indicates that we've probably needed to reopen a file because it got closed or something.
-
-        if (lastRotated == _lastRotatedAt) { OpenLog(ConstructLogFileName()); }
-    }
-}
-
-
-// ---------------------------------------------------------------------------
-// Assumes access to a mutex has already been secured.
-// ---------------------------------------------------------------------------
-void RotatedLog::CheckSizeAndShift()
-{
-    // Don't bother logging if we're supposed to exit gracefully.
-    if (_localQuitLogging) { return; }
-
-    bool openNewLog = false;
-
-    if (_rotationType == ROTATION_METHOD::ROTATE_WHEN_SIZE)
-    {
-        if (_activeFileSize >= _maxFilesizeBytes) { openNewLog = true; }
-    }
-
-    else if (_rotationType == ROTATION_METHOD::ROTATE_AFTER)
-    {
-        if (_lastRotatedAt + seconds(_rotateIntervalSeconds) < system_clock::now()) { openNewLog = true; }
-    }
-
-    if (openNewLog)
-    {
-        std::cerr << "Rotating to new log." << std::endl;
-        _logfile.close();
-        
-        RenameExistingLogs();
-
-        // Start up the new log.
-        OpenLog(ConstructLogFileName());
-    }
-}
-
-void RotatedLog::HandleQueue(const std::vector<LogData>& toLog)
-{
-    constexpr uint64_t elemSize = sizeof(decltype(_logBuffer)::value_type); // Futureproofing in case unicode or something?
-
-	std::lock(_fileLock, _configLock, _filterLock);
-    std::lock_guard<std::mutex> lock_io(_fileLock, std::adopt_lock);
-    std::lock_guard<std::mutex> lock_config(_configLock, std::adopt_lock);
-	std::lock_guard<std::mutex> lock_filters(_filterLock, std::adopt_lock);
-
-	if (system_clock::now() - _lastCheckedDiskSpace >= _diskCheckInterval) { CheckDiskSpace(); }
-
-    // Make sure the log file hasn't been deleted or something.
-    if (_localQuitLogging) { return; }
-
-	// Make sure we log to a file that actually is open.
-    if (!_logfile.is_open()) { OpenLog(ConstructLogFileName()); }
-
-    // If we can't open a file, there's no sense in trying to log to it.
-    // NOTE: This means that entries will be skipped from logging if we
-    // can't log to a file, rather than persisting until that point!
-
-    if (_logfile.is_open() && !_diskIsFull)
-    {
-		_logBuffer.clear();
-
-        // Log all the lines that are good to log.
-        for (const auto& elem : toLog)
-        {
-            if (MeetsLoggingCriteria(elem) && !_localQuitLogging)
-            {
-				_config.AppendLogToString(elem, _logBuffer);
-				_logBuffer += '\n';
-
-                if (_logBuffer.size() >= BUFFER_SIZE)
-                {
-                    _logfile << _logBuffer;
-                    _logfile.flush();
-                    _activeFileSize += _logBuffer.size() * elemSize;
-					_logBuffer.clear();
-                }
-                CheckSizeAndShift();
-            }
-        }
-
-        // If we haven't finished logging all the lines because the
-        // buffer isn't full, then we'll just log the content here so
-		// that we don't need to wait for additional content to keep being logged.
-
-        if (!_localQuitLogging && !_logBuffer.empty() && !_diskIsFull)
-        {
-			_logfile << _logBuffer;
-			_logfile.flush();
-			_activeFileSize += _logBuffer.size() * elemSize;
-			_logBuffer.clear();
-			CheckSizeAndShift();
-        }
-    }
-}
-
-void RotatedLog::ResetLogsAtTime(const unsigned hour, const unsigned minute, const unsigned second)
-{
-    std::lock_guard<std::mutex> lock(_fileLock);
-
-    _rotationHMS = {hour, minute, second};
-
-    // _monitor is set to nullptr first to clean up any remaining threads hanging around.
-    // If we reset and change data before making sure this is not in use, it might misbehave.
-    _monitorRotation = nullptr;
-
-    _rotationType = ROTATION_METHOD::ROTATE_AT;
-    OpenLog(ConstructLogFileName());
-    _monitorRotation = std::make_unique<ThreadRAII>(&RotatedLog::HandleRotateAt, this);
-}
-
-void RotatedLog::ResetLogsAfterElapsed(const uint64_t numSeconds, const int numToRotateThrough)
-{    
-    std::lock_guard<std::mutex> lock(_fileLock);
-    
-    _monitorRotation = nullptr;
-
-    _numToRotateThrough = numToRotateThrough;
-    _rotateIntervalSeconds = numSeconds;
-    _rotationType = ROTATION_METHOD::ROTATE_AFTER;
-
-    OpenLog(ConstructLogFileName());
-
-    _monitorRotation = std::make_unique<ThreadRAII>(&RotatedLog::HandleRotateAfter, this);
-}
-
-void RotatedLog::ResetLogsAtSize(const uint64_t bytes, const int numToRotateThrough)
-{
-    std::lock_guard<std::mutex> lock(_fileLock);
-
-    // There's no monitoring thread as the logging function itself will keep track of
-    // file size and switch to a new file as needed.
-
-    _monitorRotation.reset(nullptr);
-
-    _rotationType = ROTATION_METHOD::ROTATE_WHEN_SIZE;
-    _maxFilesizeBytes = bytes;
-    _numToRotateThrough = numToRotateThrough;
-
-    OpenLog(ConstructLogFileName());
-}
-
-void RotatedLog::AppendOnly()
-{
-    std::lock_guard<std::mutex> lock(_fileLock);
-
-    _monitorRotation = nullptr;
-    _rotationType = ROTATION_METHOD::NO_ROTATION;
-
-    OpenLog(ConstructLogFileName());
-}
-
-void RotatedLog::SetDiskThresholdPercent(const double d)
-{
-	_diskThreshold = d;
-}
-
-void RotatedLog::CheckDiskSpace()
-{
-		auto path = boost::filesystem::absolute(ConstructLogFileName()).parent_path();
-		if (boost::filesystem::exists(path))
-		{
-			auto diskInfo = boost::filesystem::space(path);
-			const double usedPercent = static_cast<double>(diskInfo.capacity - diskInfo.available) / static_cast<double>(diskInfo.capacity);
-
-			_diskIsFull = (usedPercent >= _diskThreshold);
-		}
-
-		_lastCheckedDiskSpace = system_clock::now();
-}
\ No newline at end of file
+#include <cstring>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/functional/hash.hpp>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "LogHandler.h"
+#include "CrashHandler.h"
+#include "ThreadPlacement.h"
+
+constexpr milliseconds DEFAULT_DISK_CHECK_INTERVAL = milliseconds(5000);
+constexpr size_t BUFFER_SIZE = 4096;
+
+// ---------------------------------------------------------------------------------
+// Implementation for LogBase
+// ---------------------------------------------------------------------------------
+LogBase::LogBase() :
+	_filterLock(),
+	_configLock(),
+	_useCache(true),
+	_localQuitLogging(false),
+    _config(),
+    _inputFilters(),
+	_sourceEvalCache(),
+	_droppedRecords(0),
+	_coalesceWindow(0),
+	_runSite(nullptr),
+	_runFormat(nullptr),
+	_runHash(0),
+	_runPayload(),
+	_runStart(),
+	_runLastSeen(),
+	_runRepeats(0),
+	_pendingSite(nullptr),
+	_pendingLastSeen(),
+	_pendingRepeats(0)
+{}
+
+LogBase::~LogBase() 
+{
+    _localQuitLogging = true;
+}
+
+void LogBase::DisableCache() 
+{
+	std::lock_guard<std::mutex> lock(_filterLock);
+	_sourceEvalCache.clear();
+	_useCache = false; 
+}
+void LogBase::EnableCache() 
+{
+	std::lock_guard<std::mutex> lock(_filterLock);
+	_useCache = true; 
+}
+
+void LogBase::EnableCoalescing(const nanoseconds window)
+{
+	std::lock_guard<std::mutex> lock(_filterLock);
+	_coalesceWindow = window;
+}
+bool LogBase::HasRepeats()
+{
+	std::lock_guard<std::mutex> lock(_filterLock);
+	return _runSite != nullptr || _pendingRepeats != 0;
+}
+
+void LogBase::DisableCoalescing()
+{
+	std::lock_guard<std::mutex> lock(_filterLock);
+
+	// The run so far is still reported, by the next batch or WriteRepeats.
+	FlushExpiredRepeats(system_clock::time_point::max());
+	_coalesceWindow = nanoseconds(0);
+}
+
+// ---------------------------------------------------------------------------------
+// ASSUMES THAT WE HAVE A LOCK ACQUIRED.  This does not lock for performance reasons,
+// and assumes that nothing will modify _inputFilters or _sourceEvalCache!
+// ---------------------------------------------------------------------------------
+bool LogBase::MeetsLoggingCriteria(const LogData& l)
+{
+	// Don't even lookup matches if we know everything's going to be logged.
+	if (_inputFilters.empty()) { return true; }
+
+	// Check and see if the value is cached already.
+	auto cachePos = _sourceEvalCache.find(l._site);
+	if (cachePos == _sourceEvalCache.end())
+	{
+		for (auto & filter : _inputFilters)
+		{
+			if (filter(l)) 
+			{
+				// Cache the value we've added since now that
+				// we know the line matches the criteria.
+				if (_useCache) { _sourceEvalCache[l._site] = true; }
+				return true;
+			}
+		}
+
+		// No match, this line is false in the cache.
+		if (_useCache) { _sourceEvalCache[l._site] = false; }
+		return false;
+	}
+
+	// Return the cached value.
+	return cachePos->second;
+}
+
+void LogBase::NoteDropped(const uint64_t numDropped)
+{
+	_droppedRecords.fetch_add(numDropped, std::memory_order_relaxed);
+}
+
+// ---------------------------------------------------------------------------------
+// The notice goes through the log's formatting, but not its filters - a log should
+// always know it's missing data.
+// ---------------------------------------------------------------------------------
+bool LogBase::AppendDroppedNotice(std::string& out)
+{
+	static const LogSite droppedSite("LogAsync", TagSet{LOG_WARNING});
+
+	const uint64_t numDropped = _droppedRecords.exchange(0, std::memory_order_relaxed);
+	if (numDropped == 0) { return false; }
+
+	LogData notice(droppedSite, std::to_string(numDropped) + " messages dropped");
+	notice._timeLogged = system_clock::now();
+	_config.AppendLogToString(notice, out);
+	return true;
+}
+
+// ---------------------------------------------------------------------------------
+// Records are compared by line, format string (for deferred printf records) and
+// payload, so a repeat is found without formatting anything.  The hash of the payload
+// rules out most records that differ before its bytes are compared.
+// ---------------------------------------------------------------------------------
+bool LogBase::CoalesceRecord(const LogData& l)
+{
+	if (_coalesceWindow.count() == 0) { return false; }
+
+	const char* content = l._logContent.data();
+	const size_t size = l._logContent.size();
+	const size_t hash = boost::hash_range(content, content + size);
+	if (l._site == _runSite && l._format == _runFormat && hash == _runHash && l._timeLogged - _runStart <= _coalesceWindow &&
+	    _runPayload.size() == size && std::memcmp(_runPayload.data(), content, size) == 0)
+	{
+		++_runRepeats;
+		_runLastSeen = l._timeLogged;
+		return true;
+	}
+
+	FlushExpiredRepeats(system_clock::time_point::max());
+
+	_runSite = l._site;
+	_runFormat = l._format;
+	_runHash = hash;
+	_runPayload.assign(content, size);
+	_runStart = l._timeLogged;
+	_runLastSeen = l._timeLogged;
+	return false;
+}
+
+void LogBase::FlushExpiredRepeats(const system_clock::time_point now)
+{
+	if (_runSite == nullptr || (now != system_clock::time_point::max() && now - _runStart <= _coalesceWindow)) { return; }
+
+	if (_runRepeats > 0)
+	{
+		_pendingSite = _runSite;
+		_pendingLastSeen = _runLastSeen;
+		_pendingRepeats = _runRepeats;
+	}
+	_runSite = nullptr;
+	_runRepeats = 0;
+}
+
+bool LogBase::AppendRepeatNotice(std::string& out)
+{
+	if (_pendingRepeats == 0) { return false; }
+
+	LogData notice(*_pendingSite, "last message repeated " + std::to_string(_pendingRepeats) + " times");
+	notice._timeLogged = _pendingLastSeen;
+	_config.AppendLogToString(notice, out);
+
+	_pendingRepeats = 0;
+	return true;
+}
+
+// ---------------------------------------------------------------------------------
+// Clears source cache because we're adding new filters that might affect the
+// result, and adds the new filter to the input list.
+// ---------------------------------------------------------------------------------
+void LogBase::AddInputFilter(FilterType&& func)
+{
+    std::lock_guard<std::mutex> lock(_filterLock);
+    _inputFilters.emplace_back(func);
+	_sourceEvalCache.clear();
+}
+
+// ---------------------------------------------------------------------------------
+// Clears source cache because we're adding new filters that might affect the
+// result, and adds the new filter to the input list.
+// ---------------------------------------------------------------------------------
+void LogBase::AddExclusiveInputFilter(FilterType&& func)
+{
+    ClearAllFilters();
+    AddInputFilter(std::move(func));
+	_sourceEvalCache.clear();
+}
+
+// ---------------------------------------------------------------------------------
+// Clears source cache because we're removing all filters.
+// ---------------------------------------------------------------------------------
+void LogBase::ClearAllFilters()
+{
+    std::lock_guard<std::mutex> lock(_filterLock);
+    _inputFilters.clear();
+	_sourceEvalCache.clear();
+}
+
+void LogBase::SetConfiguration(const std::string& logformat, const std::string& dateformat)
+{
+    std::lock_guard<std::mutex> lock(_configLock);
+	_config.SetLogFormat(logformat, dateformat);
+}
+
+void LogBase::SetFieldFormat(const FieldFormat f)
+{
+    std::lock_guard<std::mutex> lock(_configLock);
+	_config.SetFieldFormat(f);
+}
+
+// ---------------------------------------------------------------------------------
+// Implementation for RotatedLog
+// ---------------------------------------------------------------------------------
+RotatedLog::RotatedLog(const std::string& baseName) :
+	LogBase(),
+
+	_activeFileSize(0),
+	_filename(baseName),
+	_openFilename(),
+	_crashFd(-1),
+
+	_diskIsFull(false),
+	_diskThreshold(100.0),
+
+	_lastCheckedDiskSpace(system_clock::now()),
+
+	_rotationType(ROTATION_METHOD::NO_ROTATION),
+	_maxFilesizeBytes(0),
+
+	_rotateIntervalSeconds(0),
+	_numToRotateThrough(0),
+
+	_rotationHMS({0,0,0}),
+	_lastRotatedAt(system_clock::now()),
+	_diskCheckInterval(DEFAULT_DISK_CHECK_INTERVAL),
+
+    _monitorRotation(),
+
+	_pending(new char[BUFFER_SIZE]),
+	_pendingSize(0),
+	_logBuffer()
+{
+    if (_filename.empty())
+    {
+        _filename = "Unknown." + boost::lexical_cast<std::string>(time(0)) + ".log";
+    }
+
+	CheckDiskSpace();
+	RegisterCrashLog(this);
+}
+
+RotatedLog::~RotatedLog() 
+{
+	UnregisterCrashLog(this);
+	WriteRepeats(true);
+    _localQuitLogging = true;
+
+#ifndef _MSC_VER
+	if (_crashFd >= 0) { ::close(_crashFd); }
+#endif
+}
+
+void RotatedLog::RenameExistingLogs() const
+{
+    auto pathOfFile = boost::filesystem::path(_filename).parent_path();
+    const std::string baseFileName = boost::filesystem::path(_filename).filename().string();
+
+    // We're only keeping track of a max number of logfiles.  If there is an "ending" log already present,
+    // it'll need to be deleted so that we can shift newer logs into its position.
+
+    std::string deletionCandidate = baseFileName + "." + boost::lexical_cast<std::string>(_numToRotateThrough - 1);
+    if (boost::filesystem::exists(pathOfFile / deletionCandidate))
+    {
+        try
+        {
+            boost::filesystem::remove(pathOfFile / deletionCandidate);
+        }
+        catch (const boost::filesystem::filesystem_error& e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    // Any filename.n will be renamed to filename.n+1 in reverse order, unless it's the nth entry.
+    // If we're on the inital entry, it will be given a .1 prefix.
+
+    for (int i = _numToRotateThrough - 1; i > 0; --i)
+    {
+        const std::string renameCandidate = baseFileName + "." + boost::lexical_cast<std::string>(i);
+        const std::string renameTo = baseFileName + "." + boost::lexical_cast<std::string>(i + 1);
+        if (boost::filesystem::exists(pathOfFile / renameCandidate))
+        {
+            try
+            {
+                boost::filesystem::rename(pathOfFile / renameCandidate, 
+                                          pathOfFile / renameTo);
+            }
+            catch (const boost::filesystem::filesystem_error& e)
+            {
+                std::cerr << e.what() << std::endl;
+            }
+        }
+    }
+
+    // Rename the base file.  It seems like this throws a lot of false positives when
+    // running through Visual Studio but running it straight as an application has no
+    // problems.  Visual Studio's IDE probably sandboxes around the IOStream methods,
+    // so boost filesystem calls that expect for files to be totally released or unlocked
+    // may not synchronize entirely with the state of the file in the application...
+    try
+    {
+        auto basefile = pathOfFile / baseFileName;
+        auto dotOne = pathOfFile / (baseFileName + ".1");
+
+        if (boost::filesystem::exists(basefile))
+        {
+            boost::filesystem::rename(pathOfFile / baseFileName,
+                                      pathOfFile / (baseFileName + ".1"));
+        }
+    }
+    catch (const boost::filesystem::filesystem_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+
+// ---------------------------------------------------------------------------
+// Close any currently existing log, open a log with the provided name, and
+// update statistics related to loading log files.
+// ---------------------------------------------------------------------------
+void RotatedLog::OpenLog(const std::string& name)
+{
+    _logfile.close();
+    _activeFileSize = 0;
+
+    _logfile.open(name, std::ios::app);
+    _openFilename = name;
+    _logfile.sync_with_stdio(false);
+
+#ifndef _MSC_VER
+	// The crash handler's descriptor follows the file; the old one is closed after the swap so the
+	// handler never sees a descriptor that's been closed (or reused for something else).
+	const int crashFd = CrashHandlerEnabled() ? ::open(name.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC) : -1;
+	const int previousCrashFd = _crashFd.exchange(crashFd);
+	if (previousCrashFd >= 0) { ::close(previousCrashFd); }
+#endif
+
+    _lastRotatedAt = system_clock::now();
+
+    if (!_logfile.is_open())
+    {
+        std::cerr << "ERROR - Unable to open " << name << " for logging!" << std::endl;
+    }
+
+    StatFile(name);
+}
+
+// ---------------------------------------------------------------------------
+// Get the size of a given file.  It's expected to be the file currently in 
+// use by the system, which may differ from the base filename var stored
+// by the class.
+// ---------------------------------------------------------------------------
+void RotatedLog::StatFile(const std::string& filename)
+{
+    try
+    {
+        if (boost::filesystem::exists(filename) && boost::filesystem::is_regular_file(filename))
+        {
+            _activeFileSize = boost::filesystem::file_size(filename);
+        }
+    }
+    catch (const boost::filesystem::filesystem_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+    }
+}
+
+std::string RotatedLog::ConstructLogFileName() const
+{
+    switch (_rotationType)
+    {
+        case RotatedLog::ROTATION_METHOD::ROTATE_AT:
+        {
+            // The TM struct storing the day.
+            tm timeNow = {0};
+
+            const time_t tNow = system_clock::to_time_t(system_clock::now());
+            const time_t tRotated = system_clock::to_time_t(_lastRotatedAt);
+
+            LOCALTIME_FUNC(&tNow, &timeNow);
+
+            timeNow.tm_hour = _rotationHMS[0];
+            timeNow.tm_min  = _rotationHMS[1];
+            timeNow.tm_sec  = _rotationHMS[2];
+
+            time_t switchSeconds = std::mktime(&timeNow);
+
+            // If we've already switched today, use today's date.  Otherwise, we need to subtract a
+            // day because this log is still valid for yesterday - the switch today hasn't occurred!
+
+            if (tNow < switchSeconds) { switchSeconds -= 60 * 60 * 24; }
+
+            tm forFileName = {0};
+            LOCALTIME_FUNC(&switchSeconds, &forFileName);
+            return _filename + "." + TMToStringYMD(forFileName);
+        }
+
+        case RotatedLog::ROTATION_METHOD::NO_ROTATION:
+        case RotatedLog::ROTATION_METHOD::ROTATE_AFTER:
+        case RotatedLog::ROTATION_METHOD::ROTATE_WHEN_SIZE:
+        default:
+        {
+            return _filename;
+        }
+    }
+}
+
+void RotatedLog::HandleRotateAt(const volatile bool& quitEarly)
+{
+    PlacedThread placed(LogThreadRole::MAINTENANCE, "logasync-rotate");
+    while (!quitEarly && !_localQuitLogging)
+    {
+        placed.Refresh();
+        const time_t tNow = system_clock::to_time_t(system_clock::now());
+        const time_t tRotated = system_clock::to_time_t(_lastRotatedAt);
+
+        tm switchAt = {0}; 
+        LOCALTIME_FUNC(&tNow, &switchAt);
+
+        switchAt.tm_hour = _rotationHMS[0];
+        switchAt.tm_min  = _rotationHMS[1];
+        switchAt.tm_sec  = _rotationHMS[2];
+
+        const time_t switchSeconds = std::mktime(&switchAt);
+
+        if (tNow <= switchSeconds)
+        {
+            InterruptedSleepUntil(system_clock::from_time_t(switchSeconds), quitEarly);
+        }
+
+        if (quitEarly || _localQuitLogging) { return; }
+
+        std::lock_guard<std::mutex> lock(_fileLock);
+        OpenLog(ConstructLogFileName());
+    }
+}
+
+void RotatedLog::HandleRotateAfter(const volatile bool& quitEarly)
+{
+    PlacedThread placed(LogThreadRole::MAINTENANCE, "logasync-rotate");
+    while (!quitEarly && !_localQuitLogging)
+    {
+        placed.Refresh();
+        const auto lastRotated = _lastRotatedAt;
+        const auto rotateWhen = _lastRotatedAt + seconds(_rotateIntervalSeconds);
+
+        InterruptedSleepUntil(rotateWhen, quitEarly);
+        if (quitEarly || _localQuitLogging) { return; }
+
+        // Only rotate the log if the last opened time hasn't changed.
+        // If it has, it indicates that we've probably needed to reopen a file because it got closed or something.
+
+        if (lastRotated == _lastRotatedAt) { OpenLog(ConstructLogFileName()); }
+    }
+}
+
+
+// ---------------------------------------------------------------------------
+// Assumes access to a mutex has already been secured.
+// ---------------------------------------------------------------------------
+void RotatedLog::CheckSizeAndShift()
+{
+    // Don't bother logging if we're supposed to exit gracefully.
+    if (_localQuitLogging) { return; }
+
+    bool openNewLog = false;
+
+    if (_rotationType == ROTATION_METHOD::ROTATE_WHEN_SIZE)
+    {
+        if (_activeFileSize >= _maxFilesizeBytes) { openNewLog = true; }
+    }
+
+    else if (_rotationType == ROTATION_METHOD::ROTATE_AFTER)
+    {
+        if (_lastRotatedAt + seconds(_rotateIntervalSeconds) < system_clock::now()) { openNewLog = true; }
+    }
+
+    if (openNewLog)
+    {
+        std::cerr << "Rotating to new log." << std::endl;
+        _logfile.close();
+        
+        RenameExistingLogs();
+
+        // Start up the new log.
+        OpenLog(ConstructLogFileName());
+    }
+}
+
+void RotatedLog::AppendPending(const std::string& s)
+{
+	size_t pendingSize = _pendingSize.load(std::memory_order_relaxed);
+	if (pendingSize + s.size() > BUFFER_SIZE)
+	{
+		WritePending();
+		pendingSize = 0;
+	}
+
+	if (s.size() > BUFFER_SIZE)
+	{
+		_logfile << s;
+		_logfile.flush();
+		_activeFileSize += s.size();
+		return;
+	}
+
+	std::memcpy(_pending.get() + pendingSize, s.data(), s.size());
+	_pendingSize.store(pendingSize + s.size(), std::memory_order_release);
+}
+
+void RotatedLog::WritePending()
+{
+	const size_t pendingSize = _pendingSize.load(std::memory_order_relaxed);
+	if (pendingSize == 0) { return; }
+
+	_logfile.write(_pending.get(), pendingSize);
+	_logfile.flush();
+	_activeFileSize += pendingSize;
+	_pendingSize.store(0, std::memory_order_release);
+}
+
+void RotatedLog::HandleQueue(const std::vector<LogData>& toLog)
+{
+	std::lock(_fileLock, _configLock, _filterLock);
+    std::lock_guard<std::mutex> lock_io(_fileLock, std::adopt_lock);
+    std::lock_guard<std::mutex> lock_config(_configLock, std::adopt_lock);
+	std::lock_guard<std::mutex> lock_filters(_filterLock, std::adopt_lock);
+
+	if (system_clock::now() - _lastCheckedDiskSpace >= _diskCheckInterval) { CheckDiskSpace(); }
+
+    // Make sure the log file hasn't been deleted or something.
+    if (_localQuitLogging) { return; }
+
+	// Make sure we log to a file that actually is open.
+    if (!_logfile.is_open()) { OpenLog(ConstructLogFileName()); }
+
+    // If we can't open a file, there's no sense in trying to log to it.
+    // NOTE: This means that entries will be skipped from logging if we
+    // can't log to a file, rather than persisting until that point!
+
+    if (_logfile.is_open() && !_diskIsFull)
+    {
+		// Anything a previous batch couldn't write is dropped, as it always was.
+		_pendingSize.store(0, std::memory_order_release);
+
+		_logBuffer.clear();
+		if (AppendDroppedNotice(_logBuffer))
+		{
+			_logBuffer += '\n';
+			AppendPending(_logBuffer);
+		}
+
+        // Log all the lines that are good to log.
+        for (const auto& elem : toLog)
+        {
+            if (MeetsLoggingCriteria(elem) && !_localQuitLogging)
+            {
+				if (CoalesceRecord(elem)) { continue; }
+
+				_logBuffer.clear();
+				if (AppendRepeatNotice(_logBuffer)) { _logBuffer += '\n'; }
+				_config.AppendLogToString(elem, _logBuffer);
+				_logBuffer += '\n';
+
+				AppendPending(_logBuffer);
+                CheckSizeAndShift();
+            }
+        }
+
+        FlushExpiredRepeats(system_clock::now());
+		_logBuffer.clear();
+        if (AppendRepeatNotice(_logBuffer))
+		{
+			_logBuffer += '\n';
+			AppendPending(_logBuffer);
+		}
+
+        // If we haven't finished logging all the lines because the
+        // buffer isn't full, then we'll just log the content here so
+		// that we don't need to wait for additional content to keep being logged.
+
+        if (!_localQuitLogging && _pendingSize.load(std::memory_order_relaxed) != 0 && !_diskIsFull)
+        {
+			WritePending();
+			CheckSizeAndShift();
+        }
+    }
+}
+
+void RotatedLog::WriteRepeats(const bool endRun)
+{
+	std::lock(_fileLock, _configLock, _filterLock);
+    std::lock_guard<std::mutex> lock_io(_fileLock, std::adopt_lock);
+    std::lock_guard<std::mutex> lock_config(_configLock, std::adopt_lock);
+	std::lock_guard<std::mutex> lock_filters(_filterLock, std::adopt_lock);
+
+    if (_localQuitLogging || !_logfile.is_open() || _diskIsFull) { return; }
+
+	FlushExpiredRepeats(endRun ? system_clock::time_point::max() : system_clock::now());
+
+	_logBuffer.clear();
+	if (!AppendRepeatNotice(_logBuffer)) { return; }
+	_logBuffer += '\n';
+
+	AppendPending(_logBuffer);
+	WritePending();
+	CheckSizeAndShift();
+}
+
+void RotatedLog::ResetLogsAtTime(const unsigned hour, const unsigned minute, const unsigned second)
+{
+    std::lock_guard<std::mutex> lock(_fileLock);
+
+    _rotationHMS = {hour, minute, second};
+
+    // _monitor is set to nullptr first to clean up any remaining threads hanging around.
+    // If we reset and change data before making sure this is not in use, it might misbehave.
+    _monitorRotation = nullptr;
+
+    _rotationType = ROTATION_METHOD::ROTATE_AT;
+    OpenLog(ConstructLogFileName());
+    _monitorRotation = std::make_unique<ThreadRAII>(&RotatedLog::HandleRotateAt, this);
+}
+
+void RotatedLog::ResetLogsAfterElapsed(const uint64_t numSeconds, const int numToRotateThrough)
+{    
+    std::lock_guard<std::mutex> lock(_fileLock);
+    
+    _monitorRotation = nullptr;
+
+    _numToRotateThrough = numToRotateThrough;
+    _rotateIntervalSeconds = numSeconds;
+    _rotationType = ROTATION_METHOD::ROTATE_AFTER;
+
+    OpenLog(ConstructLogFileName());
+
+    _monitorRotation = std::make_unique<ThreadRAII>(&RotatedLog::HandleRotateAfter, this);
+}
+
+void RotatedLog::ResetLogsAtSize(const uint64_t bytes, const int numToRotateThrough)
+{
+    std::lock_guard<std::mutex> lock(_fileLock);
+
+    // There's no monitoring thread as the logging function itself will keep track of
+    // file size and switch to a new file as needed.
+
+    _monitorRotation.reset(nullptr);
+
+    _rotationType = ROTATION_METHOD::ROTATE_WHEN_SIZE;
+    _maxFilesizeBytes = bytes;
+    _numToRotateThrough = numToRotateThrough;
+
+    OpenLog(ConstructLogFileName());
+}
+
+void RotatedLog::AppendOnly()
+{
+    std::lock_guard<std::mutex> lock(_fileLock);
+
+    _monitorRotation = nullptr;
+    _rotationType = ROTATION_METHOD::NO_ROTATION;
+
+    OpenLog(ConstructLogFileName());
+}
+
+void RotatedLog::SetDiskThresholdPercent(const double d)
+{
+	_diskThreshold = d;
+}
+
+void RotatedLog::CheckDiskSpace()
+{
+		auto path = boost::filesystem::absolute(ConstructLogFileName()).parent_path();
+		if (boost::filesystem::exists(path))
+		{
+			auto diskInfo = boost::filesystem::space(path);
+			const double usedPercent = static_cast<double>(diskInfo.capacity - diskInfo.available) / static_cast<double>(diskInfo.capacity);
+
+			_diskIsFull = (usedPercent >= _diskThreshold);
+		}
+
+		_lastCheckedDiskSpace = system_clock::now();
+}
+
+// ---------------------------------------------------------------------------------
+// std::ofstream doesn't give out its descriptor, so the file is synced through one
+// of our own; fsync covers the file whichever descriptor it's called on.  Windows
+// has no equivalent that works on a read only handle, so there the file is only
+// flushed.
+// ---------------------------------------------------------------------------------
+void RotatedLog::Sync()
+{
+    std::lock_guard<std::mutex> lock(_fileLock);
+    if (!_logfile.is_open()) { return; }
+
+    _logfile.flush();
+#ifndef _MSC_VER
+    const int fd = ::open(_openFilename.c_str(), O_RDONLY);
+    if (fd < 0) { return; }
+    if (::fsync(fd) != 0) { std::cerr << "ERROR - Unable to sync " << _openFilename << std::endl; }
+    ::close(fd);
+#endif
+}
+
+void RotatedLog::PrepareForCrash()
+{
+#ifndef _MSC_VER
+    std::lock_guard<std::mutex> lock(_fileLock);
+    if (!_logfile.is_open() || _crashFd >= 0) { return; }
+
+    _crashFd = ::open(_openFilename.c_str(), O_WRONLY | O_APPEND | O_CLOEXEC);
+#endif
+}
+
+// ---------------------------------------------------------------------------------
+// Called from a signal handler, possibly while the sink thread is in HandleQueue.
+// _pending never moves and every byte below _pendingSize has been filled in, so
+// this only reads memory that's valid; at worst a record being written out at the
+// same time ends up in the file twice.
+// ---------------------------------------------------------------------------------
+void RotatedLog::WriteOnCrash(const char* marker, const size_t markerSize)
+{
+    const int fd = _crashFd.load(std::memory_order_acquire);
+    if (fd < 0) { return; }
+
+    CrashWrite(fd, _pending.get(), _pendingSize.load(std::memory_order_acquire));
+    CrashWrite(fd, marker, markerSize);
+}
@@ -0,0 +1,154 @@
+#include <atomic>
+#include <iostream>
+#include <unordered_map>
+
+#include <boost/thread/locks.hpp>
+#include <boost/thread/shared_mutex.hpp>
+
+#include "LogTags.h"
+
+namespace
+{
+	// --------------------------------------------------------------------------------------------
+	// All interned tags.  This is a function local static so that TagSets living in static
+	// storage (which is where the LOG_ASYNC macros put them) can't be constructed before it.
+	//
+	// A name is written before numNames is raised past its ID, and never changes after that, so
+	// names below numNames can be read without the lock.
+	// --------------------------------------------------------------------------------------------
+	struct TagRegistry
+	{
+		boost::shared_mutex lock;
+		std::unordered_map<std::string, size_t> ids;
+		std::string names[LOG_MAX_TAGS];
+		std::atomic<size_t> numNames;
+		bool reportedOverflow;
+
+		TagRegistry() : lock(), ids(), names(), numNames(0), reportedOverflow(false)
+		{
+			// Levels always occupy the first IDs so that an ID is also its LOG_LEVELS_INTEGRAL.
+			for (const char* level : {LOG_FATAL, LOG_ERROR, LOG_WARNING, LOG_INFO, LOG_DEBUG, LOG_ALL}) { Add(level); }
+		}
+
+		// Needs the lock held exclusively.
+		size_t Add(const std::string& tag)
+		{
+			const size_t id = numNames.load(std::memory_order_relaxed);
+			ids.emplace(tag, id);
+			names[id] = tag;
+			numNames.store(id + 1, std::memory_order_release);
+			return id;
+		}
+	};
+
+	TagRegistry& Registry()
+	{
+		static TagRegistry registry;
+		return registry;
+	}
+}
+
+size_t FindTagID(const std::string& tag)
+{
+	auto& registry = Registry();
+	boost::shared_lock<boost::shared_mutex> lock(registry.lock);
+
+	const auto found = registry.ids.find(tag);
+	return found == registry.ids.end() ? LOG_MAX_TAGS : found->second;
+}
+
+size_t InternTag(const std::string& tag)
+{
+	const size_t existing = FindTagID(tag);
+	if (existing != LOG_MAX_TAGS) { return existing; }
+
+	auto& registry = Registry();
+	boost::upgrade_lock<boost::shared_mutex> lock(registry.lock);
+	boost::upgrade_to_unique_lock<boost::shared_mutex> uniqueLock(lock);
+
+	// Another thread may have interned the tag while we were waiting on the lock.
+	const auto found = registry.ids.find(tag);
+	if (found != registry.ids.end()) { return found->second; }
+
+	if (registry.numNames.load(std::memory_order_relaxed) >= LOG_MAX_TAGS)
+	{
+		if (!registry.reportedOverflow)
+		{
+			std::cerr << "ERROR - More than " << LOG_MAX_TAGS << " distinct logging tags are in use; tag \"" << tag << "\" will be ignored." << std::endl;
+			registry.reportedOverflow = true;
+		}
+		return LOG_MAX_TAGS;
+	}
+
+	return registry.Add(tag);
+}
+
+TagSet::TagSet() :
+	_bits(),
+	_severity(LOG_NO_LEVEL_INT)
+{}
+
+TagSet::TagSet(std::initializer_list<const char*> tags) :
+	_bits(),
+	_severity(LOG_NO_LEVEL_INT)
+{
+	for (const char* tag : tags)
+	{
+		const size_t id = InternTag(tag);
+		if (id == LOG_MAX_TAGS) { continue; }
+
+		_bits.set(id);
+		if (id < _severity) { _severity = static_cast<unsigned>(id); }
+	}
+}
+
+TagSet::TagSet(const std::vector<std::string>& tags) :
+	_bits(),
+	_severity(LOG_NO_LEVEL_INT)
+{
+	for (const auto& tag : tags)
+	{
+		const size_t id = InternTag(tag);
+		if (id == LOG_MAX_TAGS) { continue; }
+
+		_bits.set(id);
+		if (id < _severity) { _severity = static_cast<unsigned>(id); }
+	}
+}
+
+// --------------------------------------------------------------------------------------------
+// Filters call these for every record, so rather than looking the tag up (which takes the lock,
+// and a std::string for the map) the names of the few tags in the set are compared with it.
+// --------------------------------------------------------------------------------------------
+bool TagSet::Contains(const char* tag) const
+{
+	if (_bits.none()) { return false; }
+
+	const auto& registry = Registry();
+	const size_t numNames = registry.numNames.load(std::memory_order_acquire);
+	for (size_t id = 0; id < numNames; ++id)
+	{
+		if (_bits.test(id) && registry.names[id] == tag) { return true; }
+	}
+	return false;
+}
+
+bool TagSet::Contains(const std::string& tag) const
+{
+	return Contains(tag.c_str());
+}
+
+std::vector<std::string> TagSet::Names() const
+{
+	std::vector<std::string> result;
+	if (_bits.none()) { return result; }
+
+	auto& registry = Registry();
+	boost::shared_lock<boost::shared_mutex> lock(registry.lock);
+
+	for (size_t i = 0; i < registry.numNames.load(std::memory_order_relaxed); ++i)
+	{
+		if (_bits.test(i)) { result.push_back(registry.names[i]); }
+	}
+	return result;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <bitset>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <initializer_list>
+
+// --------------------------------------------------------------------------------------------
+// Logging levels are just tags that the system knows how to rank.  They're interned before any
+// user tags so that their IDs line up with LOG_LEVELS_INTEGRAL below.
+// --------------------------------------------------------------------------------------------
+
+static const char* const LOG_FATAL   = "LOG_FATAL"; // Does not call std::terminate; just treated as a level.
+static const char* const LOG_ERROR   = "LOG_ERROR";
+static const char* const LOG_WARNING = "LOG_WARN";
+static const char* const LOG_INFO    = "LOG_INFO";
+static const char* const LOG_DEBUG   = "LOG_DEBUG";
+static const char* const LOG_ALL     = "LOG_ALL"; // Allows everything to be logged, even if no logging level tags are provided.
+
+enum LOG_LEVELS_INTEGRAL
+{
+	LOG_FATAL_INT = 0,
+	LOG_ERROR_INT = 1,
+	LOG_WARNING_INT = 2,
+	LOG_INFO_INT = 3,
+	LOG_DEBUG_INT = 4,
+	LOG_ALL_INT = 5,
+	LOG_NO_LEVEL_INT = 6, // The tag set doesn't contain any logging level at all.
+};
+
+// The maximum number of distinct tags the program can use.  Tags past this limit are reported
+// once on std::cerr and then dropped from every line using them: they aren't written with %T,
+// and TagSet::Contains (so any filter testing for one) never finds them.
+constexpr size_t LOG_MAX_TAGS = 128;
+
+// --------------------------------------------------------------------------------------------
+// Tags are interned into small integer IDs the first time they're seen.  Interning takes a
+// lock, so it should only happen once per logging line (the LOG_ASYNC macros keep a static
+// TagSet per line), never per logging call.
+//
+// Returns LOG_MAX_TAGS if the tag couldn't be interned.
+// --------------------------------------------------------------------------------------------
+size_t InternTag(const std::string& tag);
+
+// --------------------------------------------------------------------------------------------
+// Find the ID of a tag without interning it.  Returns LOG_MAX_TAGS if the tag is unknown.
+// --------------------------------------------------------------------------------------------
+size_t FindTagID(const std::string& tag);
+
+// --------------------------------------------------------------------------------------------
+// TagSet is a fixed width bitmask of interned tags.  It's cheap to copy and never allocates,
+// so it can be passed around with every logged line.
+// --------------------------------------------------------------------------------------------
+class TagSet
+{
+private:
+	std::bitset<LOG_MAX_TAGS> _bits;
+
+	// The most severe logging level in the set (LOG_NO_LEVEL_INT if there isn't one), computed
+	// once so level filtering is a single integer comparison.
+	unsigned _severity;
+
+public:
+	TagSet();
+	TagSet(std::initializer_list<const char*> tags);
+	explicit TagSet(const std::vector<std::string>& tags);
+
+	bool Contains(const char* tag) const;
+	bool Contains(const std::string& tag) const;
+	bool Intersects(const TagSet& o) const { return (_bits & o._bits).any(); }
+	bool Empty() const { return _bits.none(); }
+
+	unsigned Severity() const { return _severity; }
+
+	// --------------------------------------------------------------------------------------------
+	// Names of all tags in the set, in the order they were first interned.
+	// --------------------------------------------------------------------------------------------
+	std::vector<std::string> Names() const;
+};
@@ -1,170 +1,990 @@
-#pragma once
-
-#include <atomic>
-#include <vector>
-#include <concurrentqueue.h>
-
-#include "timsort.h"
-
-#include "ConfigurationHandler.h"
-
-constexpr uint_fast32_t LOG_DEQUE_SIZE = 1024;
-
-
-struct QueueAndSize
-{
-	std::atomic<uint64_t> _insertPos;
-	std::atomic<int_fast32_t> _writers;
-	moodycamel::ConcurrentQueue<LogData> _queue;
-
-	QueueAndSize() : _insertPos(0), _writers(0), _queue() {}
-
-	void AddToQueueUnordered(LogData && l)
-	{
-		l._insertionPoint = _insertPos++;
-		_queue.enqueue(std::move(l));
-	}
-
-	void AddToQueueOrdered(LogData&& l)
-	{
-		++_writers;
-		l._insertionPoint = _insertPos++;
-		_queue.enqueue(std::move(l));
-		--_writers;
-	}
-
-	void Reset()
-	{
-		_writers = 0;
-		_insertPos = 0;
-	}
-};
-
-
-// ------------------------------------------------------------------------------------------------------
-// Assumptions:
-// - Multiple producers, single consumer.  
-//
-// If there's multiple consumers, things will almost certainly go awry.
-// ------------------------------------------------------------------------------------------------------
-class ConcurrentQueueWrapper
-{
-private:
-	std::atomic<uint64_t> _requestsRemaining;
-
-	//std::shared_ptr<QueueAndSize> _activeQueue;
-
-	std::function<void(LogData&&)> _handleIn;
-	std::function<void(std::vector<LogData>&)> _handleOut;
-
-	QueueAndSize _queue1;
-	QueueAndSize _queue2;
-
-	QueueAndSize* _standbyQueue;
-	std::atomic<QueueAndSize*> _activeQueue;
-
-	std::vector<LogData> _tmpDequeue;
-
-	// ------------------------------------------------------------------------------------------------------
-	// Specialization for sorted queues (preserve dequeue order)
-	// ------------------------------------------------------------------------------------------------------
-	void EnqueueSorted(LogData&& l)
-	{
-		_activeQueue.load(std::memory_order_acquire)->AddToQueueOrdered(std::move(l));
-	}
-
-	// ------------------------------------------------------------------------------------------------------
-	// Specialization for unsorted queues (preserve speed)
-	// ------------------------------------------------------------------------------------------------------
-	void EnqueueUnsorted(LogData&& l)
-	{
-		_queue1.AddToQueueUnordered(std::move(l));
-	}
-
-	// ------------------------------------------------------------------------------------------------------
-	// Dequeue data in an ordered way.
-	// ------------------------------------------------------------------------------------------------------
-	void DequeueSorted(std::vector<LogData>& toWhere)
-	{
-		_standbyQueue = _activeQueue.exchange(_standbyQueue);
-
-		while (_standbyQueue->_writers.load(std::memory_order_relaxed) != 0) { std::this_thread::yield(); }
-		const uint64_t maxSize = _standbyQueue->_insertPos.load(std::memory_order_relaxed) + 1;
-		
-		if (maxSize <= 1) 
-		{
-			toWhere.clear();
-			return;
-		}
-		
-		// Timsort to sort by input ID.
-		toWhere.resize(maxSize);
-		const uint64_t actualSize = _standbyQueue->_queue.try_dequeue_bulk(toWhere.data(), maxSize);
-		toWhere.resize(actualSize);
-		gfx::timsort(toWhere.begin(), toWhere.end());
-		
-		// The sorted variant - iterate through a raw dequeue_bulk and pointer swap into a container
-		// in a sorted way - isn't as fast as timsort by far on average.
-
-		_requestsRemaining -= actualSize;
-		_standbyQueue->Reset();
-	}
-
-	// ------------------------------------------------------------------------------------------------------
-	// Dequeue data without concern for preserving the order of the queue.
-	// ------------------------------------------------------------------------------------------------------
-	void DequeueUnsorted(std::vector<LogData>& toWhere)
-	{
-		toWhere.resize(LOG_DEQUE_SIZE);
-		//const size_t numDequeued = _activeQueue->_queue.try_dequeue_bulk(toWhere.data(), LOG_DEQUE_SIZE);
-		const size_t numDequeued = _queue1._queue.try_dequeue_bulk(toWhere.data(), LOG_DEQUE_SIZE);
-		toWhere.resize(numDequeued);
-		_requestsRemaining -= numDequeued;
-	}
-
-public:
-
-	ConcurrentQueueWrapper() :
-		_requestsRemaining(0),
-		_handleIn([this](LogData&& l) { EnqueueSorted(std::move(l)); }),
-		_handleOut([this](std::vector<LogData>& toLog) { DequeueSorted(toLog); }),
-		_queue1(),
-		_queue2(),
-		_standbyQueue(nullptr),
-		_activeQueue(nullptr),
-		_tmpDequeue()
-	{
-		_standbyQueue = &_queue2;
-		_activeQueue = &_queue1;
-	}
-
-	~ConcurrentQueueWrapper() {}
-
-	// ------------------------------------------------------------------------------------------------------
-	// Load number of requests not yet processed in the queue (num in - num dequed)
-	// ------------------------------------------------------------------------------------------------------
-	uint64_t GetRequestsRemaining() const { return _requestsRemaining.load(std::memory_order_relaxed); }
-
-	void AddToQueue(LogData&& l)
-	{
-		++_requestsRemaining;
-		_handleIn(std::move(l));
-	}
-
-	void Dequeue(std::vector<LogData>& toLog)
-	{
-		_handleOut(toLog);
-	}
-
-	void HandleDataUnordered()
-	{
-		_handleIn = [this](LogData&& l) { EnqueueUnsorted(std::move(l)); };
-		_handleOut = [this](std::vector<LogData>& toLog) { DequeueUnsorted(toLog); };
-	}
-	void HandleDataOrdered()
-	{
-		_handleIn = [this](LogData&& l) { EnqueueSorted(std::move(l)); };
-		_handleOut = [this](std::vector<LogData>& toLog) { DequeueSorted(toLog); };
-	}
-
-};
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <limits>
+#include <iterator>
+#include <algorithm>
+#include <concurrentqueue.h>
+
+#include "ReorderBuffer.h"
+
+#include "ConfigurationHandler.h"
+#include "ThreadUtilities.h"
+#include "LogAsync.h"
+
+constexpr uint_fast32_t LOG_DEQUE_SIZE = 1024;
+constexpr milliseconds LOG_DEFAULT_REORDER_WINDOW(20);
+constexpr int LOG_EXPRESS_OFF = -1; // Express level that sends nothing through the express lane.
+
+constexpr size_t LOG_PRODUCER_RING_SIZE = 4096; // Records per producer thread, must be a power of 2.
+
+// Values of ProducerRing::_inFlight other than a timestamp.
+constexpr int64_t LOG_RING_IDLE = std::numeric_limits<int64_t>::max();
+constexpr int64_t LOG_RING_READING_CLOCK = std::numeric_limits<int64_t>::min();
+
+// ------------------------------------------------------------------------------------------------------
+// A fixed size single producer, single consumer ring of records owned by one producer thread.
+//
+// The producer only writes _head and _inFlight, and the consumer only writes _tail.  Rings are allocated
+// with make_shared, which doesn't align them, so rather than relying on alignment every group of fields
+// written by one side has a whole cache line of padding on both sides of it; the two threads never
+// contend on a line, and nothing allocated next to the ring shares one with them either.
+//
+// In ordered mode, _inFlight tells the consumer what the producer is up to: LOG_RING_IDLE between
+// records, LOG_RING_READING_CLOCK while it's getting a timestamp, and then the timestamp until the
+// record is in the ring.  See DequeueRingsSorted.
+// ------------------------------------------------------------------------------------------------------
+class ProducerRing
+{
+private:
+	char _padFront[LOG_CACHE_LINE_SIZE];
+
+	std::atomic<uint64_t> _head;
+	std::atomic<int64_t> _inFlight;
+	char _padHead[LOG_CACHE_LINE_SIZE];
+
+	std::atomic<uint64_t> _tail;
+	char _padTail[LOG_CACHE_LINE_SIZE];
+
+	// Read by both sides, but only written when the ring is made or abandoned.
+	std::atomic<bool> _abandoned;
+	std::vector<LogData> _slots;
+	const uint64_t _mask;
+
+public:
+	ProducerRing() :
+		_padFront(),
+		_head(0),
+		_inFlight(LOG_RING_IDLE),
+		_padHead(),
+		_tail(0),
+		_padTail(),
+		_abandoned(false),
+		_slots(LOG_PRODUCER_RING_SIZE),
+		_mask(LOG_PRODUCER_RING_SIZE - 1)
+	{
+		static_assert((LOG_PRODUCER_RING_SIZE & (LOG_PRODUCER_RING_SIZE - 1)) == 0, "LOG_PRODUCER_RING_SIZE must be a power of 2");
+	}
+
+	// Producer side; the record is only moved from if fewer than maxUsed slots were in use.
+	bool TryPush(LogData&& l, const uint64_t maxUsed = LOG_PRODUCER_RING_SIZE)
+	{
+		const uint64_t head = _head.load(std::memory_order_relaxed);
+		if (head - _tail.load(std::memory_order_acquire) >= maxUsed) { return false; }
+
+		_slots[head & _mask] = std::move(l);
+		_head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side; appends up to maxCount records to the end of toWhere.
+	size_t PopBulk(std::vector<LogData>& toWhere, const size_t maxCount)
+	{
+		const uint64_t tail = _tail.load(std::memory_order_relaxed);
+		const uint64_t available = _head.load(std::memory_order_acquire) - tail;
+		const uint64_t numPopped = std::min<uint64_t>(available, maxCount);
+
+		for (uint64_t i = 0; i < numPopped; ++i) { toWhere.emplace_back(std::move(_slots[(tail + i) & _mask])); }
+
+		_tail.store(tail + numPopped, std::memory_order_release);
+		return static_cast<size_t>(numPopped);
+	}
+
+	bool Empty() const { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_relaxed); }
+	uint64_t Size() const { return std::min<uint64_t>(_head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire), _slots.size()); }
+
+	// For the crash handler; calls f on each record still in the ring, without taking it out.
+	template <class F>
+	uint64_t PeekQueued(F f) const
+	{
+		const uint64_t head = _head.load(std::memory_order_acquire);
+		const uint64_t tail = _tail.load(std::memory_order_acquire);
+		for (uint64_t i = tail; i != head && i - tail < _slots.size(); ++i) { f(_slots[i & _mask]); }
+		return std::min<uint64_t>(head - tail, _slots.size());
+	}
+
+	// Producer side, ordered mode.
+	void AnnounceReadingClock() { _inFlight.store(LOG_RING_READING_CLOCK, std::memory_order_seq_cst); }
+	void AnnounceTimestamp(const int64_t ticks) { _inFlight.store(ticks, std::memory_order_release); }
+	void AnnounceIdle() { _inFlight.store(LOG_RING_IDLE, std::memory_order_release); }
+
+	// Consumer side, ordered mode.
+	int64_t InFlight() const { return _inFlight.load(std::memory_order_seq_cst); }
+
+	// The owning thread has exited; the ring can be dropped once it's been drained.
+	void Abandon() { _abandoned = true; }
+	bool IsAbandoned() const { return _abandoned.load(std::memory_order_acquire); }
+};
+
+
+struct QueueAndSize
+{
+	std::atomic<uint64_t> _insertPos;
+	std::atomic<int_fast32_t> _writers;
+	moodycamel::ConcurrentQueue<LogData> _queue;
+
+	QueueAndSize() : _insertPos(0), _writers(0), _queue() {}
+
+	void AddToQueueUnordered(LogData && l)
+	{
+		l._insertionPoint = _insertPos++;
+		_queue.enqueue(std::move(l));
+	}
+
+	void AddToQueueOrdered(LogData&& l)
+	{
+		++_writers;
+		l._insertionPoint = _insertPos++;
+		_queue.enqueue(std::move(l));
+		--_writers;
+	}
+
+	void Reset()
+	{
+		_writers = 0;
+		_insertPos = 0;
+	}
+};
+
+
+// ------------------------------------------------------------------------------------------------------
+// How many records one producer thread has enqueued, and how many of those the consumer has handed out,
+// for Logging::Flush.  Each side only stores to its own counts, and producers never share a counter.  The
+// counts are allocated with new, so rather than being aligned they're kept a whole cache line apart.
+//
+// Whatever the mode, a producer's records are handed out in the order it enqueued them, apart from
+// express records, which overtake the rest; they're counted apart, indexed by whether they're express.
+// ------------------------------------------------------------------------------------------------------
+class ProducerCounts
+{
+private:
+	std::atomic<uint64_t> _enqueued[2];
+	std::atomic<bool> _abandoned;
+	char _padEnqueued[LOG_CACHE_LINE_SIZE];
+
+	std::atomic<uint64_t> _handedOut[2];
+	char _padHandedOut[LOG_CACHE_LINE_SIZE];
+
+	static void Increment(std::atomic<uint64_t>& count)
+	{
+		count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+	}
+
+public:
+	ProducerCounts() : _enqueued(), _abandoned(false), _padEnqueued(), _handedOut(), _padHandedOut()
+	{
+		for (auto& count : _enqueued) { count.store(0, std::memory_order_relaxed); }
+		for (auto& count : _handedOut) { count.store(0, std::memory_order_relaxed); }
+	}
+
+	// Producer side.
+	void CountEnqueued(const bool express) { Increment(_enqueued[express]); }
+
+	// Consumer side.
+	void CountHandedOut(const bool express) { Increment(_handedOut[express]); }
+
+	uint64_t Enqueued(const bool express) const { return _enqueued[express].load(std::memory_order_acquire); }
+	bool HandedOutAll(const uint64_t numRecords, const uint64_t numExpress) const
+	{
+		return _handedOut[false].load(std::memory_order_acquire) >= numRecords && _handedOut[true].load(std::memory_order_acquire) >= numExpress;
+	}
+
+	// The owning thread has exited; another thread can take the counts over once they're all handed out.
+	void Abandon() { _abandoned.store(true, std::memory_order_release); }
+	void Claim() { _abandoned.store(false, std::memory_order_relaxed); }
+	bool IsAbandoned() const { return _abandoned.load(std::memory_order_acquire); }
+};
+
+
+// ------------------------------------------------------------------------------------------------------
+// Assumptions:
+// - Multiple producers, single consumer.  
+//
+// If there's multiple consumers, things will almost certainly go awry.
+// ------------------------------------------------------------------------------------------------------
+class ConcurrentQueueWrapper
+{
+private:
+	// Counts of records for flushing, one per producer thread.  Producers register under _producerLock,
+	// taking over the counts of a thread that's exited once everything it enqueued has been handed out.
+	// The consumer keeps its own copy of the list, and refreshes it when it hands out a record from a
+	// producer it doesn't know yet.
+	std::mutex _producerLock;
+	std::vector<std::unique_ptr<ProducerCounts>> _producers;
+	std::vector<ProducerCounts*> _consumerProducers;
+
+	// Set by Wake, so that a sleeping consumer gets up without a record being enqueued.
+	std::atomic<bool> _wakeRequested;
+
+	// Memory accounting.  While a limit is set, every record's estimated size is added on the way in
+	// (and the record marked as counted), and it's taken back out on the way out.  Without a limit,
+	// producers don't touch _bytesQueued at all.
+	std::atomic<uint64_t> _bytesQueued;
+	std::atomic<uint64_t> _memoryLimit;
+	std::atomic<Logging::OverflowPolicy> _overflowPolicy;
+	std::atomic<unsigned> _keepLevel;
+	std::atomic<int64_t> _spinMicroseconds;
+	std::atomic<uint64_t> _droppedSinceLastTake;
+	std::atomic<uint64_t> _droppedTotal;
+
+	// Lets the consumer sleep while there's nothing queued.  See WaitForRecords.
+	EventCount _recordsAvailable;
+
+	// The express lane.  Records at or above _expressLevel skip the memory limit and the rest of the
+	// queue, and are handed out before anything else.
+	std::atomic<int> _expressLevel;
+	moodycamel::ConcurrentQueue<LogData> _express;
+
+	//std::shared_ptr<QueueAndSize> _activeQueue;
+
+	std::function<bool(LogData&&)> _handleIn; // Returns false if the record was dropped.
+	std::function<void(std::vector<LogData>&)> _handleOut;
+
+	QueueAndSize _queue1;
+	QueueAndSize _queue2;
+
+	QueueAndSize* _standbyQueue;
+	std::atomic<QueueAndSize*> _activeQueue;
+
+	// Scratch space for DequeueSorted: records as they came out of the queue, and where each
+	// ascending run of insertion points in them starts and ends.
+	std::vector<LogData> _tmpDequeue;
+	std::vector<std::pair<size_t, size_t>> _tmpRuns;
+
+	// Per-thread producer rings, used instead of the shared queues if UseProducerRings is called.
+	// Producers register their rings under _ringLock; the consumer keeps its own copy of the list
+	// and only refreshes it when _ringsVersion changes.
+	bool _useRings;
+	std::mutex _ringLock;
+	std::vector<std::shared_ptr<ProducerRing>> _rings;
+	std::atomic<uint64_t> _ringsVersion;
+	std::vector<std::shared_ptr<ProducerRing>> _consumerRings;
+	uint64_t _consumerRingsVersion;
+
+	// Ordering state for rings.  Records are ordered by timestamp rather than by a shared counter; the
+	// consumer holds them in _ringReorder until no producer can still enqueue anything older than the
+	// watermark.
+	ReorderBuffer _ringReorder;
+	int64_t _ringWatermark;
+
+	// Nearly ordered mode: records are held in _windowReorder until they're a window older than
+	// _windowNewest, the newest timestamp dequeued so far.
+	ReorderBuffer _windowReorder;
+	int64_t _windowNewest;
+	std::atomic<int64_t> _windowNanoseconds;
+
+	// ------------------------------------------------------------------------------------------------------
+	// The calling thread's ring, created and registered the first time the thread logs something.
+	// ------------------------------------------------------------------------------------------------------
+	struct ProducerRingHandle
+	{
+		std::shared_ptr<ProducerRing> _ring;
+		~ProducerRingHandle() { if (_ring) { _ring->Abandon(); } }
+	};
+
+	ProducerRing& LocalRing()
+	{
+		static thread_local ProducerRingHandle handle;
+		if (!handle._ring)
+		{
+			handle._ring = std::make_shared<ProducerRing>();
+
+			std::lock_guard<std::mutex> lock(_ringLock);
+			_rings.push_back(handle._ring);
+			++_ringsVersion;
+		}
+		return *handle._ring;
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// A full ring is handled by the overflow policy, as if the memory limit had been reached: BLOCK waits
+	// for room, DROP_NEWEST drops the record, SPIN_THEN_DROP waits for the spin time first, and
+	// DROP_BY_LEVEL keeps the last eighth of the ring for records at or above the keep level.
+	// ------------------------------------------------------------------------------------------------------
+	bool PushToRing(ProducerRing& ring, LogData&& l)
+	{
+		if (ring.TryPush(std::move(l))) { return true; }
+
+		uint64_t maxUsed = LOG_PRODUCER_RING_SIZE;
+		steady_clock::time_point deadline = steady_clock::time_point::max();
+		switch (_overflowPolicy.load(std::memory_order_relaxed))
+		{
+			case Logging::OverflowPolicy::BLOCK:
+			{
+				break;
+			}
+			case Logging::OverflowPolicy::DROP_BY_LEVEL:
+			{
+				const bool keep = l._site->_level <= _keepLevel.load(std::memory_order_relaxed);
+				maxUsed = keep ? LOG_PRODUCER_RING_SIZE : LOG_PRODUCER_RING_SIZE - LOG_PRODUCER_RING_SIZE / 8;
+				deadline = steady_clock::time_point::min();
+				break;
+			}
+			case Logging::OverflowPolicy::SPIN_THEN_DROP:
+			{
+				deadline = steady_clock::now() + microseconds(_spinMicroseconds.load(std::memory_order_relaxed));
+				break;
+			}
+			case Logging::OverflowPolicy::DROP_NEWEST:
+			default:
+			{
+				deadline = steady_clock::time_point::min();
+				break;
+			}
+		}
+
+		for (unsigned attempt = 0; ; ++attempt)
+		{
+			if (ring.TryPush(std::move(l), maxUsed)) { return true; }
+			if (steady_clock::now() >= deadline)
+			{
+				if (l._memoryCounted) { _bytesQueued.fetch_sub(RecordBytes(l), std::memory_order_relaxed); }
+				NoteDropped();
+				return false;
+			}
+
+			if (attempt < 64) { std::this_thread::yield(); }
+			else { std::this_thread::sleep_for(microseconds(50)); }
+		}
+	}
+
+	void NoteDropped()
+	{
+		_droppedSinceLastTake.fetch_add(1, std::memory_order_relaxed);
+		_droppedTotal.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// The calling thread's counts, registered the first time it logs.  The record is marked with them, and
+	// counted once it's been enqueued.
+	// ------------------------------------------------------------------------------------------------------
+	struct ProducerCountsHandle
+	{
+		ProducerCounts* _counts = nullptr;
+		uint32_t _index = 0;
+		~ProducerCountsHandle() { if (_counts) { _counts->Abandon(); } }
+	};
+
+	ProducerCounts& LocalCounts(LogData& l)
+	{
+		static thread_local ProducerCountsHandle handle;
+		if (!handle._counts)
+		{
+			std::lock_guard<std::mutex> lock(_producerLock);
+			const auto reusable = std::find_if(_producers.begin(),
+											   _producers.end(),
+											   [](const std::unique_ptr<ProducerCounts>& p) { return p->IsAbandoned() && p->HandedOutAll(p->Enqueued(false), p->Enqueued(true)); });
+			if (reusable == _producers.end())
+			{
+				_producers.emplace_back(new ProducerCounts());
+				handle._index = static_cast<uint32_t>(_producers.size() - 1);
+			}
+			else { handle._index = static_cast<uint32_t>(reusable - _producers.begin()); }
+
+			handle._counts = _producers[handle._index].get();
+			handle._counts->Claim();
+		}
+
+		l._producer = handle._index;
+		return *handle._counts;
+	}
+
+	// Only called by the consumer.
+	void CountHandedOut(const LogData& l, const bool express)
+	{
+		if (l._producer >= _consumerProducers.size()) { RefreshConsumerProducers(); }
+		_consumerProducers[l._producer]->CountHandedOut(express);
+	}
+
+	void RefreshConsumerProducers()
+	{
+		std::lock_guard<std::mutex> lock(_producerLock);
+		_consumerProducers.clear();
+		for (const auto& producer : _producers) { _consumerProducers.push_back(producer.get()); }
+	}
+
+	bool TakeWakeRequest()
+	{
+		return _wakeRequested.load(std::memory_order_relaxed) && _wakeRequested.exchange(false, std::memory_order_relaxed);
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Refresh the consumer's list of rings if producers have been added, and forget about rings whose
+	// threads have exited once there's nothing left in them.
+	// ------------------------------------------------------------------------------------------------------
+	void RefreshConsumerRings()
+	{
+		bool pruneRings = false;
+		for (const auto& ring : _consumerRings)
+		{
+			if (ring->IsAbandoned() && ring->Empty()) { pruneRings = true; break; }
+		}
+
+		// Sequentially consistent, so that a consumer about to sleep doesn't miss the ring of a thread
+		// that's just logged for the first time.
+		if (!pruneRings && _ringsVersion.load(std::memory_order_seq_cst) == _consumerRingsVersion) { return; }
+
+		std::lock_guard<std::mutex> lock(_ringLock);
+		if (pruneRings)
+		{
+			_rings.erase(std::remove_if(_rings.begin(),
+										_rings.end(),
+										[](const std::shared_ptr<ProducerRing>& r) { return r->IsAbandoned() && r->Empty(); }),
+						 _rings.end());
+		}
+		_consumerRings = _rings;
+		_consumerRingsVersion = _ringsVersion.load(std::memory_order_acquire);
+	}
+
+	size_t DrainRings(std::vector<LogData>& toWhere, const size_t maxPerRing)
+	{
+		size_t numDrained = 0;
+		for (auto& ring : _consumerRings) { numDrained += ring->PopBulk(toWhere, maxPerRing); }
+		return numDrained;
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Specialization for sorted queues (preserve dequeue order)
+	// ------------------------------------------------------------------------------------------------------
+	bool EnqueueSorted(LogData&& l)
+	{
+		_activeQueue.load(std::memory_order_acquire)->AddToQueueOrdered(std::move(l));
+		return true;
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Specialization for unsorted queues (preserve speed)
+	// ------------------------------------------------------------------------------------------------------
+	bool EnqueueUnsorted(LogData&& l)
+	{
+		_queue1.AddToQueueUnordered(std::move(l));
+		return true;
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Ring specializations of the above.
+	// ------------------------------------------------------------------------------------------------------
+	bool EnqueueRingSorted(LogData&& l)
+	{
+		ProducerRing& ring = LocalRing();
+
+		// Stamp the record again now that the consumer can see we're about to enqueue it.
+		ring.AnnounceReadingClock();
+		l._clockTicks = ReadClockTicks();
+		ring.AnnounceTimestamp(l._clockTicks);
+
+		const bool pushed = PushToRing(ring, std::move(l));
+		ring.AnnounceIdle();
+		return pushed;
+	}
+
+	bool EnqueueRingUnsorted(LogData&& l)
+	{
+		return PushToRing(LocalRing(), std::move(l));
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Dequeue data in an ordered way.
+	// ------------------------------------------------------------------------------------------------------
+	void DequeueSorted(std::vector<LogData>& toWhere)
+	{
+		_standbyQueue = _activeQueue.exchange(_standbyQueue);
+
+		while (_standbyQueue->_writers.load(std::memory_order_relaxed) != 0) { std::this_thread::yield(); }
+		const uint64_t maxSize = _standbyQueue->_insertPos.load(std::memory_order_relaxed) + 1;
+		
+		if (maxSize <= 1) 
+		{
+			toWhere.clear();
+			return;
+		}
+		
+		_tmpDequeue.resize(maxSize);
+		const uint64_t actualSize = _standbyQueue->_queue.try_dequeue_bulk(_tmpDequeue.data(), maxSize);
+		_tmpDequeue.resize(actualSize);
+		MergeInsertionRuns(_tmpDequeue, toWhere);
+		_tmpDequeue.clear();
+
+		_standbyQueue->Reset();
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Dequeue in timestamp order, trusting that records are enqueued within the window of each other.
+	//
+	// Producers enqueue exactly as they do unordered.  Everything dequeued is moved into _windowReorder,
+	// and the records stamped at least a window before the newest one seen are handed out in order.  Once
+	// the queue has been emptied, the clock reading taken beforehand stands in for the newest record, so
+	// records aren't held forever when nothing new is logged.  A record that's stamped more than a window
+	// before one that's already been dequeued is handed out right away, out of order.
+	//
+	// The shared queue hands records out grouped by producer, so a partial dequeue can be all one busy
+	// producer's, stamped well after records another producer still has queued.  The queue is therefore
+	// drained until it comes back short before the newest timestamp is raised; producers format their
+	// records and the consumer only moves them, so it catches up.  Rings are drained whole every time.
+	//
+	// Held records haven't been handed out, so flushing waits for them.
+	// ------------------------------------------------------------------------------------------------------
+	void DequeueWindowed(std::vector<LogData>& toWhere)
+	{
+		const int64_t now = ReadClockTicks();
+
+		std::vector<LogData>& pending = _windowReorder.Pending();
+		const size_t numHeld = pending.size();
+		if (_useRings)
+		{
+			RefreshConsumerRings();
+			DrainRings(pending, std::numeric_limits<size_t>::max());
+		}
+		else
+		{
+			for (size_t numDequeued = LOG_DEQUE_SIZE; numDequeued == LOG_DEQUE_SIZE; )
+			{
+				const size_t numBefore = pending.size();
+				pending.resize(numBefore + LOG_DEQUE_SIZE);
+				numDequeued = _queue1._queue.try_dequeue_bulk(pending.data() + numBefore, LOG_DEQUE_SIZE);
+				pending.resize(numBefore + numDequeued);
+			}
+		}
+
+		for (size_t i = numHeld; i < pending.size(); ++i) { _windowNewest = std::max(_windowNewest, pending[i]._clockTicks); }
+		_windowNewest = std::max(_windowNewest, now);
+
+		const ClockCalibration calibration = CurrentClockCalibration();
+		const int64_t watermark = _windowNewest - calibration.ToTicks(nanoseconds(_windowNanoseconds.load(std::memory_order_relaxed)));
+		_windowReorder.Release(watermark, toWhere);
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// The queue hands records out grouped by producer, and each producer's records are already in order
+	// of insertion point.  Rather than sorting the whole vector (which moves every record several times),
+	// find those runs and merge them with a heap of run fronts, so each record is moved exactly once.
+	// ------------------------------------------------------------------------------------------------------
+	void MergeInsertionRuns(std::vector<LogData>& from, std::vector<LogData>& toWhere)
+	{
+		_tmpRuns.clear();
+		size_t runStart = 0;
+		for (size_t i = 1; i < from.size(); ++i)
+		{
+			if (from[i]._insertionPoint < from[i - 1]._insertionPoint)
+			{
+				_tmpRuns.emplace_back(runStart, i);
+				runStart = i;
+			}
+		}
+		_tmpRuns.emplace_back(runStart, from.size());
+
+		if (_tmpRuns.size() == 1)
+		{
+			toWhere.swap(from);
+			return;
+		}
+
+		// Min heap on the insertion point at the front of each run.
+		const auto later = [&from](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b)
+		{
+			return from[a.first]._insertionPoint > from[b.first]._insertionPoint;
+		};
+		std::make_heap(_tmpRuns.begin(), _tmpRuns.end(), later);
+
+		toWhere.clear();
+		toWhere.reserve(from.size());
+		while (!_tmpRuns.empty())
+		{
+			std::pop_heap(_tmpRuns.begin(), _tmpRuns.end(), later);
+			auto& run = _tmpRuns.back();
+			toWhere.emplace_back(std::move(from[run.first++]));
+
+			if (run.first == run.second) { _tmpRuns.pop_back(); }
+			else { std::push_heap(_tmpRuns.begin(), _tmpRuns.end(), later); }
+		}
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Dequeue data without concern for preserving the order of the queue.
+	// ------------------------------------------------------------------------------------------------------
+	void DequeueUnsorted(std::vector<LogData>& toWhere)
+	{
+		toWhere.resize(LOG_DEQUE_SIZE);
+		//const size_t numDequeued = _activeQueue->_queue.try_dequeue_bulk(toWhere.data(), LOG_DEQUE_SIZE);
+		const size_t numDequeued = _queue1._queue.try_dequeue_bulk(toWhere.data(), LOG_DEQUE_SIZE);
+		toWhere.resize(numDequeued);
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Dequeue from the rings without concern for preserving the order of the queue.
+	// ------------------------------------------------------------------------------------------------------
+	void DequeueRingsUnsorted(std::vector<LogData>& toWhere)
+	{
+		toWhere.clear();
+		RefreshConsumerRings();
+		DrainRings(toWhere, LOG_DEQUE_SIZE);
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Dequeue from the rings in timestamp order.
+	//
+	// The watermark is the newest timestamp nothing older than can still be enqueued.  Starting from
+	// the clock (read before anything else, so that any producer we don't see yet stamps its record later
+	// than this), it's lowered to the timestamp of any record that's on its way into a ring.  A producer
+	// caught reading the clock started after our last look at it, so its record is no older than the
+	// last watermark, which is used instead.
+	//
+	// Everything in the rings is drained after that, and the records at or before the watermark are
+	// handed out in order; the rest wait for a later dequeue.  There's no counter shared between
+	// producers, so they never contend with each other.
+	// ------------------------------------------------------------------------------------------------------
+	void DequeueRingsSorted(std::vector<LogData>& toWhere)
+	{
+		int64_t watermark = ReadClockTicks();
+		RefreshConsumerRings();
+
+		for (const auto& ring : _consumerRings)
+		{
+			const int64_t inFlight = ring->InFlight();
+			watermark = std::min(watermark, inFlight == LOG_RING_READING_CLOCK ? _ringWatermark : inFlight);
+		}
+
+		DrainRings(_ringReorder.Pending(), std::numeric_limits<size_t>::max());
+		_ringWatermark = watermark;
+
+		_ringReorder.Release(watermark, toWhere);
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Overflow handling.
+	// ------------------------------------------------------------------------------------------------------
+	static uint64_t RecordBytes(const LogData& l)
+	{
+		return sizeof(LogData) + (l._logContent.IsSpilled() ? l._logContent.size() : 0);
+	}
+
+	// Claim room for a record if the total stays at or under the threshold.  A record always fits in an
+	// empty queue, so one bigger than the threshold still gets through rather than waiting forever.
+	bool TryReserve(const uint64_t bytes, const uint64_t threshold)
+	{
+		const uint64_t queued = _bytesQueued.fetch_add(bytes, std::memory_order_relaxed);
+		if (queued == 0 || queued + bytes <= threshold) { return true; }
+
+		_bytesQueued.fetch_sub(bytes, std::memory_order_relaxed);
+		return false;
+	}
+
+	// Wait (spinning at first, then sleeping briefly) until there's room or the deadline passes.
+	bool WaitToReserve(const uint64_t bytes, const uint64_t limit, const steady_clock::time_point deadline)
+	{
+		for (unsigned attempt = 0; ; ++attempt)
+		{
+			if (TryReserve(bytes, limit)) { return true; }
+			if (steady_clock::now() >= deadline) { return false; }
+
+			if (attempt < 64) { std::this_thread::yield(); }
+			else { std::this_thread::sleep_for(microseconds(50)); }
+		}
+	}
+
+	// Returns false if the record should be dropped.
+	bool ReserveRoomFor(LogData& l)
+	{
+		const uint64_t limit = _memoryLimit.load(std::memory_order_relaxed);
+		if (limit == 0) { return true; }
+
+		l._memoryCounted = true;
+		const uint64_t bytes = RecordBytes(l);
+		switch (_overflowPolicy.load(std::memory_order_relaxed))
+		{
+			case Logging::OverflowPolicy::BLOCK:
+			{
+				return WaitToReserve(bytes, limit, steady_clock::time_point::max());
+			}
+			case Logging::OverflowPolicy::DROP_BY_LEVEL:
+			{
+				const bool keep = l._site->_level <= _keepLevel.load(std::memory_order_relaxed);
+				return TryReserve(bytes, keep ? limit : limit - limit / 8);
+			}
+			case Logging::OverflowPolicy::SPIN_THEN_DROP:
+			{
+				const auto deadline = steady_clock::now() + microseconds(_spinMicroseconds.load(std::memory_order_relaxed));
+				return WaitToReserve(bytes, limit, deadline);
+			}
+			case Logging::OverflowPolicy::DROP_NEWEST:
+			default:
+			{
+				return TryReserve(bytes, limit);
+			}
+		}
+	}
+
+public:
+
+	ConcurrentQueueWrapper() :
+		_producerLock(),
+		_producers(),
+		_consumerProducers(),
+		_wakeRequested(false),
+		_bytesQueued(0),
+		_memoryLimit(0),
+		_overflowPolicy(Logging::OverflowPolicy::BLOCK),
+		_keepLevel(LOG_WARNING_INT),
+		_spinMicroseconds(1000),
+		_droppedSinceLastTake(0),
+		_droppedTotal(0),
+		_recordsAvailable(),
+		_expressLevel(LOG_EXPRESS_OFF),
+		_express(),
+		_handleIn([this](LogData&& l) { return EnqueueSorted(std::move(l)); }),
+		_handleOut([this](std::vector<LogData>& toLog) { DequeueSorted(toLog); }),
+		_queue1(),
+		_queue2(),
+		_standbyQueue(nullptr),
+		_activeQueue(nullptr),
+		_tmpDequeue(),
+		_tmpRuns(),
+		_useRings(false),
+		_ringLock(),
+		_rings(),
+		_ringsVersion(0),
+		_consumerRings(),
+		_consumerRingsVersion(0),
+		_ringReorder(),
+		_ringWatermark(std::numeric_limits<int64_t>::min()),
+		_windowReorder(),
+		_windowNewest(std::numeric_limits<int64_t>::min()),
+		_windowNanoseconds(nanoseconds(LOG_DEFAULT_REORDER_WINDOW).count())
+	{
+		_standbyQueue = &_queue2;
+		_activeQueue = &_queue1;
+	}
+
+	~ConcurrentQueueWrapper() {}
+
+	// ------------------------------------------------------------------------------------------------------
+	// For the crash handler: calls f on every record still waiting in a producer ring, returning how many
+	// there were.  Nothing is locked or taken out, so it's only safe when nothing else will touch the queue
+	// again.  The shared queues can't be walked this way.
+	// ------------------------------------------------------------------------------------------------------
+	template <class F>
+	uint64_t PeekQueuedInRings(F f) const
+	{
+		if (!_useRings) { return 0; }
+
+		uint64_t numPeeked = 0;
+		for (const auto& ring : _rings) { numPeeked += ring->PeekQueued(f); }
+		return numPeeked;
+	}
+
+	// For the crash handler: the number of records not handed out yet, as near as the queues can tell.
+	// Doesn't lock, like the above.
+	uint64_t QueuedOnCrash() const
+	{
+		uint64_t numQueued = _express.size_approx() + _queue1._queue.size_approx() + _queue2._queue.size_approx();
+		numQueued += _windowReorder.Size() + _ringReorder.Size();
+		if (_useRings)
+		{
+			for (const auto& ring : _rings) { numQueued += ring->Size(); }
+		}
+		return numQueued;
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Is anything waiting to be dequeued?  Records held back for ordering don't count.  Only called by
+	// the consumer.
+	// ------------------------------------------------------------------------------------------------------
+	bool HasQueued()
+	{
+		if (_express.size_approx() != 0) { return true; }
+		if (!_useRings) { return _activeQueue.load(std::memory_order_acquire)->_queue.size_approx() != 0; }
+
+		RefreshConsumerRings();
+		return std::any_of(_consumerRings.begin(), _consumerRings.end(), [](const std::shared_ptr<ProducerRing>& r) { return !r->Empty(); });
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Flushing.  Logging::Flush takes what every producer has enqueued so far, normal records and then
+	// express ones, and the consumer checks whether it's handed them all out.  Records logged after the
+	// call, express or not, can't stand in for earlier ones, as they're counted for each producer.
+	// ------------------------------------------------------------------------------------------------------
+	std::vector<uint64_t> FlushTargets()
+	{
+		std::lock_guard<std::mutex> lock(_producerLock);
+		std::vector<uint64_t> targets;
+		targets.reserve(2 * _producers.size());
+		for (const auto& producer : _producers)
+		{
+			targets.push_back(producer->Enqueued(false));
+			targets.push_back(producer->Enqueued(true));
+		}
+		return targets;
+	}
+
+	// Only called by the consumer.
+	bool FlushReached(const std::vector<uint64_t>& targets)
+	{
+		if (targets.size() / 2 > _consumerProducers.size()) { RefreshConsumerProducers(); }
+		for (size_t i = 0; i < targets.size() / 2; ++i)
+		{
+			if (!_consumerProducers[i]->HandedOutAll(targets[2 * i], targets[2 * i + 1])) { return false; }
+		}
+		return true;
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Producers publish the record before notifying, which is what WaitForRecords relies on.
+	// ------------------------------------------------------------------------------------------------------
+	void AddToQueue(LogData&& l)
+	{
+		if (IsExpress(l))
+		{
+			if (_memoryLimit.load(std::memory_order_relaxed) != 0)
+			{
+				l._memoryCounted = true;
+				_bytesQueued.fetch_add(RecordBytes(l), std::memory_order_relaxed);
+			}
+			ProducerCounts& counts = LocalCounts(l);
+			_express.enqueue(std::move(l));
+			counts.CountEnqueued(true);
+			_recordsAvailable.Notify();
+			return;
+		}
+
+		if (!ReserveRoomFor(l))
+		{
+			NoteDropped();
+			return;
+		}
+
+		ProducerCounts& counts = LocalCounts(l);
+		if (!_handleIn(std::move(l))) { return; }
+		counts.CountEnqueued(false);
+		_recordsAvailable.Notify();
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Returns true if the records came from the express lane.  Express records are handed out on their
+	// own, ahead of the rest of the queue, so they're out of order with respect to it.
+	// ------------------------------------------------------------------------------------------------------
+	bool Dequeue(std::vector<LogData>& toLog)
+	{
+		bool express = false;
+		if (_express.size_approx() != 0)
+		{
+			toLog.resize(LOG_DEQUE_SIZE);
+			const size_t numDequeued = _express.try_dequeue_bulk(toLog.data(), LOG_DEQUE_SIZE);
+			toLog.resize(numDequeued);
+			express = numDequeued != 0;
+		}
+		if (!express) { _handleOut(toLog); }
+
+		uint64_t bytes = 0;
+		for (const auto& l : toLog)
+		{
+			bytes += l._memoryCounted ? RecordBytes(l) : 0;
+			CountHandedOut(l, express);
+		}
+		if (bytes != 0) { _bytesQueued.fetch_sub(bytes, std::memory_order_relaxed); }
+		return express;
+	}
+
+	// See Logging::SetExpressLevel.
+	void SetExpressLevel(const int level) { _expressLevel = level; }
+	bool IsExpress(const LogData& l) const
+	{
+		return static_cast<int>(l._site->_level) <= _expressLevel.load(std::memory_order_relaxed);
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Called by the consumer when a dequeue came back empty.  Producers publish their record before
+	// notifying, so a consumer that finds nothing queued after announcing itself is guaranteed a wakeup
+	// from the next record.  Wake works the same way.
+	//
+	// Records held back by nearly ordered mode don't count as something to do, but the consumer doesn't
+	// sleep for more than a fraction of the window while there are any, so they're released on time.
+	// ------------------------------------------------------------------------------------------------------
+	void WaitForRecords(IdleBackoff& backoff)
+	{
+		const auto ready = [this] { return HasQueued() || TakeWakeRequest(); };
+		if (_windowReorder.Size() == 0)
+		{
+			backoff.Pause(_recordsAvailable, ready);
+			return;
+		}
+
+		const nanoseconds window(_windowNanoseconds.load(std::memory_order_relaxed));
+		const nanoseconds parkTimeout = std::max<nanoseconds>(milliseconds(1), std::min<nanoseconds>(LOG_IDLE_PARK_TIMEOUT, window / 8));
+		backoff.Pause(_recordsAvailable, ready, parkTimeout);
+	}
+
+	// Gets a consumer sleeping in WaitForRecords up, or keeps it from going to sleep next time.
+	void Wake()
+	{
+		_wakeRequested.store(true, std::memory_order_release);
+		_recordsAvailable.Notify();
+	}
+
+	// ------------------------------------------------------------------------------------------------------
+	// Memory limits.  See Logging::SetQueueMemoryLimit.
+	// ------------------------------------------------------------------------------------------------------
+	void SetMemoryLimit(const uint64_t maxBytes, const Logging::OverflowPolicy p)
+	{
+		_overflowPolicy = p;
+		_memoryLimit = maxBytes;
+	}
+	void SetKeepLevel(const unsigned level) { _keepLevel = level; }
+	void SetSpinTime(const microseconds t) { _spinMicroseconds = t.count(); }
+
+	// Number of records dropped since this was last called.
+	uint64_t TakeDroppedCount() { return _droppedSinceLastTake.exchange(0, std::memory_order_relaxed); }
+	uint64_t GetDroppedTotal() const { return _droppedTotal.load(std::memory_order_relaxed); }
+
+	// ------------------------------------------------------------------------------------------------------
+	// Use a ring per producer thread rather than the shared queues.  This needs to be called before
+	// HandleDataUnordered/HandleDataOrdered.
+	// ------------------------------------------------------------------------------------------------------
+	void UseProducerRings()
+	{
+		_useRings = true;
+	}
+
+	void HandleDataUnordered()
+	{
+		if (_useRings)
+		{
+			_handleIn = [this](LogData&& l) { return EnqueueRingUnsorted(std::move(l)); };
+			_handleOut = [this](std::vector<LogData>& toLog) { DequeueRingsUnsorted(toLog); };
+		}
+		else
+		{
+			_handleIn = [this](LogData&& l) { return EnqueueUnsorted(std::move(l)); };
+			_handleOut = [this](std::vector<LogData>& toLog) { DequeueUnsorted(toLog); };
+		}
+	}
+	void HandleDataWindowed()
+	{
+		if (_useRings) { _handleIn = [this](LogData&& l) { return EnqueueRingUnsorted(std::move(l)); }; }
+		else { _handleIn = [this](LogData&& l) { return EnqueueUnsorted(std::move(l)); }; }
+		_handleOut = [this](std::vector<LogData>& toLog) { DequeueWindowed(toLog); };
+	}
+
+	void SetReorderWindow(const nanoseconds window)
+	{
+		_windowNanoseconds.store(window.count(), std::memory_order_relaxed);
+	}
+
+	void HandleDataOrdered()
+	{
+		if (_useRings)
+		{
+			_handleIn = [this](LogData&& l) { return EnqueueRingSorted(std::move(l)); };
+			_handleOut = [this](std::vector<LogData>& toLog) { DequeueRingsSorted(toLog); };
+		}
+		else
+		{
+			_handleIn = [this](LogData&& l) { return EnqueueSorted(std::move(l)); };
+			_handleOut = [this](std::vector<LogData>& toLog) { DequeueSorted(toLog); };
+		}
+	}
+
+};
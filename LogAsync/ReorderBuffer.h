@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <iterator>
+#include <algorithm>
+
+#include "timsort.h"
+#include "ConfigurationHandler.h"
+
+// ------------------------------------------------------------------------------------------------------
+// Holds records until nothing stamped earlier can still show up, and then hands them out in timestamp
+// (LogData::_clockTicks) order.
+//
+// Records are sorted with a stable sort, so records with the same timestamp stay in the order they
+// were added.  As long as each producer's records are added in the order it logged them, every
+// producer's records come out in that order too.
+// ------------------------------------------------------------------------------------------------------
+class ReorderBuffer
+{
+private:
+	// Records before _first have been released already, and the ones from _first up to _sorted are in
+	// order.  Released records are only erased once they're most of the vector, so releasing a few
+	// records doesn't move everything held back behind them.
+	std::vector<LogData> _pending;
+	size_t _first;
+	size_t _sorted;
+
+	static bool StampedBefore(const LogData& a, const LogData& b) { return a._clockTicks < b._clockTicks; }
+
+public:
+	ReorderBuffer() : _pending(), _first(0), _sorted(0) {}
+
+	// New records are appended to this.
+	std::vector<LogData>& Pending() { return _pending; }
+	size_t Size() const { return _pending.size() - _first; }
+
+	// ------------------------------------------------------------------------------------------------------
+	// Replaces the contents of toWhere with every record stamped at or before watermark, oldest first.
+	// ------------------------------------------------------------------------------------------------------
+	size_t Release(const int64_t watermark, std::vector<LogData>& toWhere)
+	{
+		toWhere.clear();
+
+		// Sort what was added since last time, and merge it into whatever it overlaps of the records
+		// held back before.
+		const auto first = _pending.begin() + _first;
+		const auto sorted = _pending.begin() + _sorted;
+		gfx::timsort(sorted, _pending.end(), StampedBefore);
+		if (sorted != first && sorted != _pending.end() && StampedBefore(*sorted, *(sorted - 1)))
+		{
+			std::inplace_merge(std::upper_bound(first, sorted, *sorted, StampedBefore), sorted, _pending.end(), StampedBefore);
+		}
+
+		const auto end = std::upper_bound(first,
+										  _pending.end(),
+										  watermark,
+										  [](const int64_t w, const LogData& l) { return w < l._clockTicks; });
+
+		if (first == _pending.begin() && end == _pending.end())
+		{
+			toWhere.swap(_pending);
+			_first = _sorted = 0;
+			return toWhere.size();
+		}
+
+		toWhere.assign(std::make_move_iterator(first), std::make_move_iterator(end));
+		_first = end - _pending.begin();
+
+		if (_first == _pending.size())
+		{
+			_pending.clear();
+			_first = 0;
+		}
+		else if (_first > _pending.size() / 2)
+		{
+			_pending.erase(_pending.begin(), _pending.begin() + _first);
+			_first = 0;
+		}
+		_sorted = _pending.size();
+
+		return toWhere.size();
+	}
+};
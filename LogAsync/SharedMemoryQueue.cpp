@@ -0,0 +1,520 @@
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "SharedMemoryQueue.h"
+#include "LogArguments.h"
+#include "LogClock.h"
+#include "LogContext.h"
+#include "ThreadPlacement.h"
+
+constexpr uint64_t SHARED_MIN_LANE_SIZE = 4096;
+
+namespace
+{
+	// The writer the pthread_atfork handlers look after.
+	std::atomic<SharedLaneWriter*> forkingWriter(nullptr);
+
+	// What collectors have rebuilt.  Only the collecting thread touches them, and they're never freed,
+	// as records in the queue (or logged after static destruction starts) still point at them.
+	std::unordered_map<std::string, std::unique_ptr<LogSite>>& CollectedSites()
+	{
+		static auto sites = new std::unordered_map<std::string, std::unique_ptr<LogSite>>();
+		return *sites;
+	}
+
+	std::unordered_set<std::string>& CollectedStrings()
+	{
+		static auto strings = new std::unordered_set<std::string>();
+		return *strings;
+	}
+
+	SharedLane* LaneOf(SharedQueueHeader* header, const uint32_t i)
+	{
+		char* lanes = reinterpret_cast<char*>(header + 1);
+		return reinterpret_cast<SharedLane*>(lanes + i * (sizeof(SharedLane) + header->_laneBytes));
+	}
+
+	size_t SegmentSize(const uint32_t numLanes, const uint64_t laneBytes)
+	{
+		return sizeof(SharedQueueHeader) + numLanes * (sizeof(SharedLane) + laneBytes);
+	}
+
+	// Processes may use different clock sources, so records travel with wall clock time.
+	int64_t WallNanoseconds(const int64_t ticks)
+	{
+		const ClockSource s = ActiveClockSourceRef().load(std::memory_order_relaxed);
+		if (s == ClockSource::SYSTEM || s == ClockSource::REALTIME_COARSE) { return ticks; }
+		return duration_cast<nanoseconds>(CurrentClockCalibration().ToTimePoint(ticks).time_since_epoch()).count();
+	}
+
+#ifndef _MSC_VER
+	void BeforeForkHandler()  { if (auto w = forkingWriter.load()) { w->BeforeFork(); } }
+	void ParentForkHandler()  { if (auto w = forkingWriter.load()) { w->AfterForkInParent(); } }
+	void ChildForkHandler()   { if (auto w = forkingWriter.load()) { w->AfterForkInChild(); } }
+#endif
+}
+
+// ---------------------------------------------------------------------------------
+// Implementation for SharedLaneWriter
+// ---------------------------------------------------------------------------------
+SharedLaneWriter::SharedLaneWriter() :
+	_name(),
+	_mapping(nullptr),
+	_mappingSize(0),
+	_header(nullptr),
+	_lock(),
+	_lane(nullptr),
+	_warnedNoLane(false),
+	_fields(),
+	_context()
+{}
+
+SharedLaneWriter::~SharedLaneWriter()
+{
+	SharedLaneWriter* self = this;
+	forkingWriter.compare_exchange_strong(self, nullptr);
+#ifndef _MSC_VER
+	if (_mapping != nullptr) { munmap(_mapping, _mappingSize); }
+#endif
+}
+
+std::unique_ptr<SharedLaneWriter> SharedLaneWriter::Open(const std::string& name)
+{
+#ifdef _MSC_VER
+	std::cerr << "WARNING - The shared memory queue needs POSIX shared memory, which this platform doesn't have." << std::endl;
+	return nullptr;
+#else
+	const int fd = shm_open(name.c_str(), O_RDWR, 0);
+	if (fd < 0)
+	{
+		std::cerr << "ERROR - Unable to open the shared logging queue " << name << "; is its collector running?" << std::endl;
+		return nullptr;
+	}
+
+	struct stat info;
+	const bool sized = fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(SharedQueueHeader);
+	void* mapping = sized ? mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		std::cerr << "ERROR - Unable to map the shared logging queue " << name << "!" << std::endl;
+		return nullptr;
+	}
+
+	auto header = static_cast<SharedQueueHeader*>(mapping);
+	if (header->_magic.load(std::memory_order_acquire) != LOG_SHARED_MAGIC || header->_version != LOG_SHARED_VERSION ||
+	    SegmentSize(header->_numLanes, header->_laneBytes) > static_cast<size_t>(info.st_size))
+	{
+		std::cerr << "ERROR - " << name << " isn't a shared logging queue this version of LogAsync can use!" << std::endl;
+		munmap(mapping, info.st_size);
+		return nullptr;
+	}
+
+	std::unique_ptr<SharedLaneWriter> writer(new SharedLaneWriter());
+	writer->_name = name;
+	writer->_mapping = mapping;
+	writer->_mappingSize = info.st_size;
+	writer->_header = header;
+
+	static std::once_flag registerForkHandlers;
+	std::call_once(registerForkHandlers, [] { pthread_atfork(BeforeForkHandler, ParentForkHandler, ChildForkHandler); });
+	forkingWriter = writer.get();
+
+	return writer;
+#endif
+}
+
+// ---------------------------------------------------------------------------------
+// A lane this process already owns is reused, in case it attached before.
+// Assumes _lock is held.
+// ---------------------------------------------------------------------------------
+bool SharedLaneWriter::ClaimLane()
+{
+#ifndef _MSC_VER
+	const int32_t pid = static_cast<int32_t>(getpid());
+	for (int pass = 0; pass < 2 && _lane == nullptr; ++pass)
+	{
+		for (uint32_t i = 0; i < _header->_numLanes; ++i)
+		{
+			SharedLane* lane = LaneOf(_header, i);
+			int32_t expected = pass == 0 ? pid : 0;
+			if (lane->_owner.compare_exchange_strong(expected, pid))
+			{
+				_lane = lane;
+				break;
+			}
+		}
+	}
+#endif
+
+	if (_lane == nullptr && !_warnedNoLane)
+	{
+		std::cerr << "ERROR - Every lane of the shared logging queue " << _name << " is taken; this process's records are being dropped." << std::endl;
+		_warnedNoLane = true;
+	}
+	return _lane != nullptr;
+}
+
+// ---------------------------------------------------------------------------------
+// Records are written in place.  One that would run past the end of the lane is
+// written at the start instead, after a padding record covering the end.
+// ---------------------------------------------------------------------------------
+void SharedLaneWriter::Write(const LogData& l)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	if (_lane == nullptr && !ClaimLane()) { return; }
+
+	const LogSite& site = *l._site;
+	const char* format = (l._payloadKind == PayloadKind::DEFERRED_PRINTF && l._format != nullptr) ? l._format : "";
+	const size_t formatSize = std::strlen(format);
+
+	_context.clear();
+	if (l._context) { ExportFields(l._context->_fields.data(), l._context->_fields.size(), _context); }
+
+	const char* content = l._logContent.data();
+	size_t contentSize = l._logContent.size();
+	if (l._payloadKind == PayloadKind::FIELDS)
+	{
+		_fields.clear();
+		ExportFields(content, contentSize, _fields);
+		content = _fields.data();
+		contentSize = _fields.size();
+	}
+
+	const uint64_t unpadded = sizeof(SharedRecordHeader) + site._source.size() + site._tagList.size() + formatSize + _context.size() + contentSize;
+	const uint64_t size = (unpadded + LOG_SHARED_ALIGNMENT - 1) & ~static_cast<uint64_t>(LOG_SHARED_ALIGNMENT - 1);
+	const uint64_t capacity = _header->_laneBytes;
+	const uint64_t mask = capacity - 1;
+
+	uint64_t head = _lane->_head.load(std::memory_order_relaxed);
+	const uint64_t toEnd = capacity - (head & mask);
+	const uint64_t needed = toEnd < size ? toEnd + size : size;
+	const auto hasRoom = [&]() { return capacity - (head - _lane->_tail.load(std::memory_order_acquire)) >= needed; };
+
+	// A record this big would hog the lane; it's dropped like one that doesn't fit.
+	bool fits = size <= capacity / 4 && hasRoom();
+	if (!fits && size <= capacity / 4)
+	{
+		const auto giveUpAt = steady_clock::now() + LOG_SHARED_FULL_WAIT;
+		do { std::this_thread::yield(); } while (!(fits = hasRoom()) && steady_clock::now() < giveUpAt);
+	}
+	if (!fits)
+	{
+		_lane->_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	char* data = _lane->Data();
+	if (toEnd < size)
+	{
+		const uint32_t paddingSize = static_cast<uint32_t>(toEnd);
+		std::memcpy(data + (head & mask), &paddingSize, sizeof(uint32_t));
+		data[(head & mask) + offsetof(SharedRecordHeader, _kind)] = static_cast<char>(LOG_SHARED_PADDING);
+		head += toEnd;
+	}
+
+	SharedRecordHeader h;
+	std::memset(&h, 0, sizeof(h));
+	h._size = static_cast<uint32_t>(size);
+	h._kind = static_cast<uint8_t>(l._payloadKind);
+	h._wallNanoseconds = WallNanoseconds(l._clockTicks);
+	h._sourceSize = static_cast<uint32_t>(site._source.size());
+	h._tagsSize = static_cast<uint32_t>(site._tagList.size());
+	h._formatSize = static_cast<uint32_t>(formatSize);
+	h._contextSize = static_cast<uint32_t>(_context.size());
+	h._contentSize = static_cast<uint32_t>(contentSize);
+
+	char* out = data + (head & mask);
+	auto append = [&out](const char* s, const size_t n) { std::memcpy(out, s, n); out += n; };
+	append(reinterpret_cast<const char*>(&h), sizeof(h));
+	append(site._source.data(), site._source.size());
+	append(site._tagList.data(), site._tagList.size());
+	append(format, formatSize);
+	append(_context.data(), _context.size());
+	append(content, contentSize);
+
+	_lane->_head.store(head + size, std::memory_order_release);
+}
+
+void SharedLaneWriter::BeforeFork()
+{
+	_lock.lock();
+}
+
+void SharedLaneWriter::AfterForkInParent()
+{
+	_lock.unlock();
+}
+
+void SharedLaneWriter::AfterForkInChild()
+{
+	_lane = nullptr;
+	_warnedNoLane = false;
+	_lock.unlock();
+}
+
+// ---------------------------------------------------------------------------------
+// Implementation for SharedCollector
+// ---------------------------------------------------------------------------------
+SharedCollector::SharedCollector(const std::string& name, std::function<void(LogData&&)>&& submit) :
+	_name(name),
+	_mapping(nullptr),
+	_mappingSize(0),
+	_header(nullptr),
+	_submit(std::move(submit)),
+	_scratch(),
+	_lastReclaimed(steady_clock::now()),
+	_collect()
+{}
+
+SharedCollector::~SharedCollector()
+{
+	_collect = nullptr;
+
+#ifndef _MSC_VER
+	if (_mapping != nullptr)
+	{
+		munmap(_mapping, _mappingSize);
+		shm_unlink(_name.c_str());
+	}
+#endif
+}
+
+std::unique_ptr<SharedCollector> SharedCollector::Create(const std::string& name, const unsigned numLanes, const uint64_t laneBytes,
+                                                         std::function<void(LogData&&)> submit)
+{
+#ifdef _MSC_VER
+	std::cerr << "WARNING - The shared memory queue needs POSIX shared memory, which this platform doesn't have." << std::endl;
+	return nullptr;
+#else
+	uint64_t roundedLaneBytes = SHARED_MIN_LANE_SIZE;
+	while (roundedLaneBytes < laneBytes) { roundedLaneBytes *= 2; }
+
+	if (numLanes == 0)
+	{
+		std::cerr << "ERROR - A shared logging queue needs at least one lane!" << std::endl;
+		return nullptr;
+	}
+
+	// A segment left behind by a collector that didn't shut down would have stale lanes.
+	shm_unlink(name.c_str());
+	const int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+	if (fd < 0)
+	{
+		std::cerr << "ERROR - Unable to create the shared logging queue " << name << "!" << std::endl;
+		return nullptr;
+	}
+
+	const size_t size = SegmentSize(numLanes, roundedLaneBytes);
+	void* mapping = ftruncate(fd, size) == 0 ? mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		std::cerr << "ERROR - Unable to size or map the shared logging queue " << name << "!" << std::endl;
+		shm_unlink(name.c_str());
+		return nullptr;
+	}
+
+	std::unique_ptr<SharedCollector> collector(new SharedCollector(name, std::move(submit)));
+	collector->_mapping = mapping;
+	collector->_mappingSize = size;
+
+	// Producers check the magic number before anything else, so it goes in last.
+	auto header = new (mapping) SharedQueueHeader();
+	header->_version = LOG_SHARED_VERSION;
+	header->_numLanes = numLanes;
+	header->_laneBytes = roundedLaneBytes;
+	for (uint32_t i = 0; i < numLanes; ++i) { new (LaneOf(header, i)) SharedLane(); }
+	header->_magic.store(LOG_SHARED_MAGIC, std::memory_order_release);
+
+	collector->_header = header;
+	collector->_collect = std::make_unique<ThreadRAII>(&SharedCollector::Collect, collector.get());
+	return collector;
+#endif
+}
+
+const LogSite& SharedCollector::SiteFor(const char* source, const uint32_t sourceSize, const char* tags, const uint32_t tagsSize)
+{
+	std::string key(source, sourceSize);
+	key += '\n';
+	key.append(tags, tagsSize);
+
+	auto& sites = CollectedSites();
+	auto found = sites.find(key);
+	if (found != sites.end()) { return *found->second; }
+
+	// The tag list is the tags joined by ", ", as LogSite builds it.
+	std::vector<std::string> names;
+	const std::string tagList(tags, tagsSize);
+	for (size_t start = 0; start < tagList.size();)
+	{
+		const size_t end = std::min(tagList.find(", ", start), tagList.size());
+		names.push_back(tagList.substr(start, end - start));
+		start = end + 2;
+	}
+
+	auto site = std::make_unique<LogSite>(std::string(source, sourceSize).c_str(), TagSet(names));
+	const LogSite& result = *site;
+	sites.emplace(std::move(key), std::move(site));
+	return result;
+}
+
+const char* SharedCollector::Intern(const char* s, const size_t size)
+{
+	return CollectedStrings().emplace(s, size).first->c_str();
+}
+
+// ---------------------------------------------------------------------------------
+// Producers only ever publish whole records, but a lane is memory another process
+// can scribble on; a record that doesn't make sense throws away the rest of its lane.
+// ---------------------------------------------------------------------------------
+size_t SharedCollector::Drain()
+{
+	const ClockCalibration calibration = CurrentClockCalibration();
+	const uint64_t mask = _header->_laneBytes - 1;
+	const auto intern = [this](const char* s, const size_t size) { return Intern(s, size); };
+	const auto corrupt = [this](const uint32_t lane)
+	{
+		std::cerr << "ERROR - Lane " << lane << " of the shared logging queue " << _name << " is corrupt; skipping what's in it." << std::endl;
+	};
+	size_t numCollected = 0;
+
+	for (uint32_t i = 0; i < _header->_numLanes; ++i)
+	{
+		SharedLane* lane = LaneOf(_header, i);
+		const char* data = lane->Data();
+		uint64_t tail = lane->_tail.load(std::memory_order_relaxed);
+		const uint64_t head = lane->_head.load(std::memory_order_acquire);
+
+		while (tail != head)
+		{
+			const char* in = data + (tail & mask);
+
+			SharedRecordHeader h;
+			std::memcpy(&h._size, in, sizeof(uint32_t));
+			h._kind = static_cast<uint8_t>(in[offsetof(SharedRecordHeader, _kind)]);
+
+			if (h._size < LOG_SHARED_ALIGNMENT || h._size > head - tail || (tail & mask) + h._size > _header->_laneBytes ||
+			    (h._kind != LOG_SHARED_PADDING && (h._size < sizeof(h) || h._kind > static_cast<uint8_t>(PayloadKind::FIELDS))))
+			{
+				corrupt(i);
+				tail = head;
+				break;
+			}
+			if (h._kind == LOG_SHARED_PADDING)
+			{
+				tail += h._size;
+				continue;
+			}
+
+			// Summed in 64 bits, so that huge sizes can't wrap around.
+			std::memcpy(&h, in, sizeof(h));
+			const uint64_t used = sizeof(h) + static_cast<uint64_t>(h._sourceSize) + h._tagsSize + h._formatSize + h._contextSize + h._contentSize;
+			if (used > h._size)
+			{
+				corrupt(i);
+				tail = head;
+				break;
+			}
+
+			in += sizeof(h);
+			const char* source = in;  in += h._sourceSize;
+			const char* tags = in;    in += h._tagsSize;
+			const char* format = in;  in += h._formatSize;
+			const char* context = in; in += h._contextSize;
+			const char* content = in;
+
+			const PayloadKind kind = static_cast<PayloadKind>(h._kind);
+			auto imported = h._contextSize > 0 ? std::make_shared<LogContext>() : nullptr;
+			_scratch.clear();
+			if ((imported && !ImportFields(context, h._contextSize, intern, imported->_fields)) ||
+			    (kind == PayloadKind::FIELDS && !ImportFields(content, h._contentSize, intern, _scratch)))
+			{
+				corrupt(i);
+				tail = head;
+				break;
+			}
+
+			LogData l;
+			l._clockTicks = calibration.TicksAt(h._wallNanoseconds);
+			l._site = &SiteFor(source, h._sourceSize, tags, h._tagsSize);
+			l._payloadKind = kind;
+			l._format = h._formatSize > 0 ? Intern(format, h._formatSize) : nullptr;
+			l._context = std::move(imported);
+
+			if (kind == PayloadKind::FIELDS) { l._logContent.Assign(_scratch.data(), _scratch.size()); }
+			else { l._logContent.Assign(content, h._contentSize); }
+
+			_submit(std::move(l));
+			tail += h._size;
+			++numCollected;
+		}
+		lane->_tail.store(tail, std::memory_order_release);
+
+		const uint64_t numDropped = lane->_dropped.exchange(0, std::memory_order_relaxed);
+		if (numDropped > 0) { ReportDropped(lane->_owner.load(std::memory_order_relaxed), numDropped); }
+	}
+
+	return numCollected;
+}
+
+void SharedCollector::ReportDropped(const int32_t owner, const uint64_t numDropped)
+{
+	static const LogSite site("SharedCollector", TagSet{LOG_WARNING});
+	_submit(LogData(site, std::to_string(numDropped) + " records from process " + std::to_string(owner) + " were dropped; its lane of the shared queue was full"));
+}
+
+// ---------------------------------------------------------------------------------
+// A lane is freed once its process has exited and everything it logged has been
+// collected.
+// ---------------------------------------------------------------------------------
+void SharedCollector::ReclaimLanes()
+{
+#ifndef _MSC_VER
+	for (uint32_t i = 0; i < _header->_numLanes; ++i)
+	{
+		SharedLane* lane = LaneOf(_header, i);
+		int32_t owner = lane->_owner.load(std::memory_order_acquire);
+		if (owner == 0 || lane->_head.load(std::memory_order_acquire) != lane->_tail.load(std::memory_order_relaxed)) { continue; }
+
+		if (kill(owner, 0) != 0 && errno == ESRCH) { lane->_owner.compare_exchange_strong(owner, 0); }
+	}
+#endif
+}
+
+void SharedCollector::Collect(const volatile bool& quit)
+{
+	PlacedThread placed(LogThreadRole::QUEUE, "logasync-collect");
+	while (!quit)
+	{
+		placed.Refresh();
+		if (Drain() == 0) { std::this_thread::sleep_for(LOG_SHARED_POLL_INTERVAL); }
+
+		const auto now = steady_clock::now();
+		if (now - _lastReclaimed >= LOG_SHARED_RECLAIM_INTERVAL)
+		{
+			ReclaimLanes();
+			_lastReclaimed = now;
+		}
+	}
+
+	// Whatever was logged before the collector was stopped still gets logged.
+	Drain();
+}
@@ -0,0 +1,164 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "ConfigurationHandler.h"
+#include "ThreadUtilities.h"
+
+constexpr uint32_t LOG_SHARED_MAGIC = 0x51474F4C;          // "LOGQ", written once the collector has set the segment up.
+constexpr uint32_t LOG_SHARED_VERSION = 2;
+constexpr uint32_t LOG_SHARED_ALIGNMENT = 8;               // Records start on this boundary within a lane.
+constexpr uint8_t LOG_SHARED_PADDING = 0xFF;               // Record kind of the unused end of a lane, before it wraps.
+constexpr milliseconds LOG_SHARED_POLL_INTERVAL(1);        // How long the collector sleeps when every lane is empty.
+constexpr milliseconds LOG_SHARED_RECLAIM_INTERVAL(1000);  // How often the collector looks for lanes of exited processes.
+constexpr microseconds LOG_SHARED_FULL_WAIT(1000);         // How long a producer waits for room in a full lane.
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2, "Shared memory lanes need lock free atomics");
+
+// ------------------------------------------------------------------------------------------------------
+// Layout of the shared memory segment: a SharedQueueHeader, then _numLanes lanes of
+// sizeof(SharedLane) + _laneBytes each.
+//
+// Every process that logs claims a lane of its own by swapping its pid into _owner, so processes never
+// contend with each other; threads of the same process take turns on their process's lane.  A lane is
+// a single producer, single consumer ring of bytes: the producing process only writes _head and the
+// collector only writes _tail, both counting bytes ever written/read.  Once a lane's process has exited
+// and the lane is drained, the collector frees it for another process.
+// ------------------------------------------------------------------------------------------------------
+struct SharedQueueHeader
+{
+	std::atomic<uint32_t> _magic;
+	uint32_t _version;
+	uint32_t _numLanes;
+	uint32_t _padding;
+	uint64_t _laneBytes;
+	char _padHeader[LOG_CACHE_LINE_SIZE - 3 * sizeof(uint32_t) - sizeof(std::atomic<uint32_t>) - sizeof(uint64_t)];
+};
+
+struct SharedLane
+{
+	std::atomic<uint64_t> _head;
+	std::atomic<uint64_t> _dropped; // Records the owner couldn't fit, not reported by the collector yet.
+	std::atomic<int32_t> _owner;    // pid of the process the lane belongs to, or 0 if it's free.
+	char _padHead[LOG_CACHE_LINE_SIZE - 2 * sizeof(std::atomic<uint64_t>) - sizeof(std::atomic<int32_t>)];
+
+	std::atomic<uint64_t> _tail;
+	char _padTail[LOG_CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+
+	char* Data() { return reinterpret_cast<char*>(this + 1); }
+};
+
+// ------------------------------------------------------------------------------------------------------
+// A record in a lane: the header, then the source, the tag list, the printf format (DEFERRED_PRINTF
+// only), the scoped context and the payload, padded out to LOG_SHARED_ALIGNMENT.  Pointers only mean
+// something in the process that logged them, so everything is carried by value; field keys are written
+// out as strings (see ExportFields).
+// ------------------------------------------------------------------------------------------------------
+struct SharedRecordHeader
+{
+	uint32_t _size;           // The whole record, header and padding included.
+	uint8_t _kind;            // PayloadKind, or LOG_SHARED_PADDING.
+	uint8_t _padding[3];
+	int64_t _wallNanoseconds; // Timestamps are wall clock time, as processes don't share clock calibrations.
+	uint32_t _sourceSize;
+	uint32_t _tagsSize;
+	uint32_t _formatSize;
+	uint32_t _contextSize;
+	uint32_t _contentSize;
+	uint32_t _padding2;
+};
+
+// ------------------------------------------------------------------------------------------------------
+// The producing side: takes the place of the queue in a process attached with
+// Logging::AttachToSharedQueue.  Records that don't fit in the lane within LOG_SHARED_FULL_WAIT are
+// dropped rather than holding the process up any longer, and the collector reports how many.
+// ------------------------------------------------------------------------------------------------------
+class SharedLaneWriter
+{
+private:
+	std::string _name;
+	void* _mapping;
+	size_t _mappingSize;
+	SharedQueueHeader* _header;
+
+	// The lane of this process, claimed by the first record logged.  A forked child gets its own.
+	std::mutex _lock;
+	SharedLane* _lane;
+	bool _warnedNoLane;
+
+	// Scratch space for fields and context, whose keys are rewritten as strings.
+	std::string _fields;
+	std::string _context;
+
+	SharedLaneWriter();
+
+	bool ClaimLane();
+
+public:
+	~SharedLaneWriter();
+
+	SharedLaneWriter(const SharedLaneWriter&) = delete;
+	SharedLaneWriter& operator=(const SharedLaneWriter&) = delete;
+
+	// Maps the segment a collector has set up, or returns nullptr (with a message to cerr).
+	static std::unique_ptr<SharedLaneWriter> Open(const std::string& name);
+
+	void Write(const LogData& l);
+
+	// pthread_atfork handlers, so the lane lock isn't held in the child and the child claims a lane.
+	void BeforeFork();
+	void AfterForkInParent();
+	void AfterForkInChild();
+};
+
+// ------------------------------------------------------------------------------------------------------
+// The collecting side: creates the segment and runs a thread that moves records from every lane into
+// this process's queue (through submit), where the logs and sockets registered here pick them up.
+//
+// Sites, format strings and field keys are rebuilt once per distinct value.  Records point at them and
+// can outlive the collector, so they're kept for the life of the process, as LOG_ASYNC's sites are.
+// ------------------------------------------------------------------------------------------------------
+class SharedCollector
+{
+private:
+	std::string _name;
+	void* _mapping;
+	size_t _mappingSize;
+	SharedQueueHeader* _header;
+
+	std::function<void(LogData&&)> _submit;
+
+	std::string _scratch;
+	steady_clock::time_point _lastReclaimed;
+
+	std::unique_ptr<ThreadRAII> _collect;
+
+	SharedCollector(const std::string& name, std::function<void(LogData&&)>&& submit);
+
+	const LogSite& SiteFor(const char* source, const uint32_t sourceSize, const char* tags, const uint32_t tagsSize);
+	const char* Intern(const char* s, const size_t size);
+
+	// Hands everything in the lanes to submit, returning how many records there were.
+	size_t Drain();
+	void ReportDropped(const int32_t owner, const uint64_t numDropped);
+	void ReclaimLanes();
+
+	void Collect(const volatile bool& quit);
+
+public:
+	// Everything left in the lanes is collected before the segment is removed.
+	~SharedCollector();
+
+	SharedCollector(const SharedCollector&) = delete;
+	SharedCollector& operator=(const SharedCollector&) = delete;
+
+	// Creates the segment (replacing any left behind by a collector that died) and starts collecting,
+	// or returns nullptr (with a message to cerr).  laneBytes is rounded up to a power of 2.
+	static std::unique_ptr<SharedCollector> Create(const std::string& name, const unsigned numLanes, const uint64_t laneBytes,
+	                                               std::function<void(LogData&&)> submit);
+};
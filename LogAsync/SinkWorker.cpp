@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <concurrentqueue.h>
+
+#include "SinkWorker.h"
+#include "BufferPool.h"
+#include "ThreadPlacement.h"
+
+namespace
+{
+	// Emptied batch vectors, kept for the logging thread to fill again.  Never destroyed, as the worker
+	// that drops a batch's last reference may still be running when statics are torn down.
+	moodycamel::ConcurrentQueue<std::vector<LogData>>& FreedBatches()
+	{
+		static auto* freed = new moodycamel::ConcurrentQueue<std::vector<LogData>>();
+		return *freed;
+	}
+}
+
+LogBatch MakeLogBatch(std::vector<LogData>&& records)
+{
+	return LogBatch(new std::vector<LogData>(std::move(records)), [](std::vector<LogData>* batch)
+	{
+		RecycleLogBuffers(*batch);
+		batch->clear();
+
+		auto& freed = FreedBatches();
+		if (freed.size_approx() < LOG_BATCH_POOL_SIZE) { freed.enqueue(std::move(*batch)); }
+		delete batch;
+	});
+}
+
+std::vector<LogData> TakeBatchStorage()
+{
+	std::vector<LogData> storage;
+	FreedBatches().try_dequeue(storage);
+	return storage;
+}
+
+FlushBarrier::FlushBarrier(const bool sync) :
+	_lock(),
+	_done(),
+	_sync(sync),
+	_posted(false),
+	_pending(0)
+{
+}
+
+void FlushBarrier::Posted(const size_t numWorkers)
+{
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_posted = true;
+		_pending = numWorkers;
+	}
+	if (numWorkers == 0) { _done.notify_all(); }
+}
+
+void FlushBarrier::Arrive()
+{
+	bool last = false;
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		last = --_pending == 0;
+	}
+	if (last) { _done.notify_all(); }
+}
+
+bool FlushBarrier::WaitFor(const milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(_lock);
+	return _done.wait_for(lock, timeout, [this] { return _posted && _pending == 0; });
+}
+
+SinkWorker::SinkWorker() :
+	_lock(),
+	_wakeup(),
+	_room(),
+	_inbox(),
+	_express(),
+	_numBatches(0),
+	_numUndelivered(0),
+	_logs(),
+	_quit(false),
+	_thread()
+{
+	_thread = std::thread([this] { Run(); });
+}
+
+SinkWorker::~SinkWorker()
+{
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_quit = true;
+	}
+	_wakeup.notify_one();
+	if (_thread.joinable()) { _thread.join(); }
+}
+
+void SinkWorker::AddLog(const std::shared_ptr<LogBase>& log)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	_logs.push_back(log);
+}
+
+void SinkWorker::RemoveExpiredLogs()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	_logs.erase(std::remove_if(_logs.begin(), _logs.end(), [](const std::weak_ptr<LogBase>& l) { return l.expired(); }), _logs.end());
+}
+
+size_t SinkWorker::NumLogs()
+{
+	std::lock_guard<std::mutex> lock(_lock);
+	return std::count_if(_logs.begin(), _logs.end(), [](const std::weak_ptr<LogBase>& l) { return !l.expired(); });
+}
+
+void SinkWorker::Post(const LogBatch& batch, const bool express)
+{
+	_numUndelivered.fetch_add(batch->size(), std::memory_order_relaxed);
+	{
+		std::unique_lock<std::mutex> lock(_lock);
+		if (express) { _express.push_back(batch); }
+		else
+		{
+			_room.wait(lock, [this] { return _numBatches < LOG_SINK_INBOX_SIZE; });
+			_inbox.push_back({batch, nullptr});
+			++_numBatches;
+		}
+	}
+	_wakeup.notify_one();
+}
+
+void SinkWorker::PostBarrier(const std::shared_ptr<FlushBarrier>& barrier)
+{
+	{
+		std::lock_guard<std::mutex> lock(_lock);
+		_inbox.push_back({nullptr, barrier});
+	}
+	_wakeup.notify_one();
+}
+
+// ---------------------------------------------------------------------------------
+// Logs are only held onto while a batch is being handled, so they can still go away
+// (and stop being logged to) as soon as their owners let go of them.  While one of its
+// logs has repeats it hasn't written the count of (see LogBase::HasRepeats), the worker
+// also wakes every LOG_SINK_IDLE_INTERVAL with nothing to do, so a run whose window has
+// passed gets its count logged; otherwise it sleeps until it's posted something.
+// ---------------------------------------------------------------------------------
+void SinkWorker::Run()
+{
+	std::vector<std::weak_ptr<LogBase>> logs;
+	PlacedThread placed(LogThreadRole::SINK, "logasync-sink");
+	bool hasRepeats = false;
+
+	for (;;)
+	{
+		Work work;
+		bool idle = false;
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+			const auto hasWork = [this] { return _quit || !_inbox.empty() || !_express.empty(); };
+			if (hasRepeats) { idle = !_wakeup.wait_for(lock, LOG_SINK_IDLE_INTERVAL, hasWork); }
+			else { _wakeup.wait(lock, hasWork); }
+
+			if (!idle)
+			{
+				if (!_express.empty())
+				{
+					work._batch = std::move(_express.front());
+					_express.pop_front();
+				}
+				else if (!_inbox.empty())
+				{
+					work = std::move(_inbox.front());
+					_inbox.pop_front();
+					if (work._batch && _numBatches-- == LOG_SINK_INBOX_SIZE) { _room.notify_one(); }
+				}
+				else { return; }
+			}
+			logs = _logs;
+		}
+
+		placed.Refresh();
+		if (idle)
+		{
+			for (const auto& l : logs)
+			{
+				if (auto log = l.lock()) { log->WriteRepeats(false); }
+			}
+		}
+		else if (work._batch)
+		{
+			for (const auto& l : logs)
+			{
+				if (auto log = l.lock()) { log->HandleQueue(*work._batch); }
+			}
+			_numUndelivered.fetch_sub(work._batch->size(), std::memory_order_relaxed);
+		}
+		else
+		{
+			for (const auto& l : logs)
+			{
+				if (auto log = l.lock()) { log->WriteRepeats(true); }
+			}
+
+			if (work._barrier->Sync())
+			{
+				for (const auto& l : logs)
+				{
+					if (auto log = l.lock()) { log->Sync(); }
+				}
+			}
+			work._barrier->Arrive();
+		}
+
+		// Runs only start (and end up as repeats to write) while this thread handles a batch,
+		// so checking after each pass is enough to know whether to wake up by itself.
+		hasRepeats = false;
+		for (const auto& l : logs)
+		{
+			if (auto log = l.lock()) { hasRepeats = hasRepeats || log->HasRepeats(); }
+		}
+	}
+}
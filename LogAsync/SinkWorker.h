@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include "LogHandler.h"
+
+// ------------------------------------------------------------------------------------
+// Handing records to logs.
+//
+// Each log/socket gets a worker thread of its own, unless Logging::SetSinkThreads caps the
+// number of workers and logs have to share them.  A worker is fed through a bounded inbox of
+// batches and writes every batch to each of its logs in turn.  A log only ever belongs to one
+// worker, so it sees records in the order they were dequeued.  A batch is shared by every
+// worker it was posted to and is freed (with its payload buffers recycled) once the last of
+// them is done with it, so the logging thread doesn't wait on a log, and a slow log (a socket
+// that's timing out, a file on a stalled disk) holds up no other log, or with a cap only the
+// logs sharing its worker.
+//
+// Until a worker falls LOG_SINK_INBOX_SIZE batches behind, that is.  The logging thread then
+// waits for room in its inbox rather than losing records, so the queue backs up and what
+// happens next is up to Logging::SetQueueMemoryLimit's policy, as it would be without the
+// workers.  Express batches (see Logging::SetExpressLevel) don't count towards the limit, and
+// are handled before anything else waiting.
+// ------------------------------------------------------------------------------------
+constexpr size_t LOG_SINK_INBOX_SIZE = 64;
+constexpr size_t LOG_BATCH_POOL_SIZE = 8; // Freed batch vectors kept around for reuse.
+constexpr milliseconds LOG_SINK_IDLE_INTERVAL(100); // How often a worker whose logs have repeats to write wakes up by itself.
+
+typedef std::shared_ptr<const std::vector<LogData>> LogBatch;
+
+// Takes the records, recycling their buffers (and the vector itself) when the batch is freed.
+LogBatch MakeLogBatch(std::vector<LogData>&& records);
+
+// An empty vector to dequeue the next batch into, reused from a freed batch if there is one.
+std::vector<LogData> TakeBatchStorage();
+
+// ------------------------------------------------------------------------------------
+// A Logging::Flush in progress.  The logging thread posts it to every worker once the
+// records it's waiting for have been dispatched, and each worker arrives at it after
+// writing (and, if asked to, syncing) everything posted before it.
+// ------------------------------------------------------------------------------------
+class FlushBarrier
+{
+private:
+	std::mutex _lock;
+	std::condition_variable _done;
+	const bool _sync;
+	bool _posted;
+	size_t _pending;
+
+public:
+	explicit FlushBarrier(const bool sync);
+
+	bool Sync() const { return _sync; }
+
+	// Called by the logging thread before posting the barrier to numWorkers workers.
+	void Posted(const size_t numWorkers);
+	void Arrive();
+
+	// False if the timeout passed before every worker arrived.
+	bool WaitFor(const milliseconds timeout);
+};
+
+class SinkWorker
+{
+private:
+	std::mutex _lock;
+	std::condition_variable _wakeup;
+	std::condition_variable _room; // Signalled whenever a batch leaves a full inbox.
+	// Entries are either a batch or a flush barrier.  Only batches count towards the inbox limit.
+	struct Work
+	{
+		LogBatch _batch;
+		std::shared_ptr<FlushBarrier> _barrier;
+	};
+
+	std::deque<Work> _inbox;
+	std::deque<LogBatch> _express;
+	size_t _numBatches;
+	std::atomic<uint64_t> _numUndelivered; // Records posted and not yet written to every log.
+	std::vector<std::weak_ptr<LogBase>> _logs;
+	bool _quit;
+
+	std::thread _thread;
+
+	void Run();
+
+public:
+	SinkWorker();
+	SinkWorker(const SinkWorker&) = delete;
+	SinkWorker& operator=(const SinkWorker&) = delete;
+
+	// Finishes the batches already posted, and stops the thread.
+	~SinkWorker();
+
+	// Logs are held weakly; they stop being written to once their owner lets go of them.
+	void AddLog(const std::shared_ptr<LogBase>& log);
+	void RemoveExpiredLogs();
+	size_t NumLogs(); // Those still owned.
+
+	// Waits for room if the inbox is full, unless the batch is express.
+	void Post(const LogBatch& batch, const bool express = false);
+
+	// Barriers are never dropped.
+	void PostBarrier(const std::shared_ptr<FlushBarrier>& barrier);
+
+	// For the crash handler, so it doesn't lock.
+	uint64_t NumUndelivered() const { return _numUndelivered.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,149 @@
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "ThreadPlacement.h"
+
+namespace
+{
+	// What each role asks for, and a count of changes to it that threads compare theirs against.
+	std::mutex placementLock;
+	ThreadPlacement placements[LOG_THREAD_ROLES];
+	std::atomic<uint32_t> placementVersions[LOG_THREAD_ROLES];
+
+	// Threads of a role tend to fail the same way, so each change only gets one warning.
+	std::atomic<uint32_t> warnedVersions[LOG_THREAD_ROLES];
+
+	size_t RoleIndex(const LogThreadRole role)
+	{
+		return static_cast<size_t>(role);
+	}
+
+	const char* RoleName(const LogThreadRole role)
+	{
+		switch (role)
+		{
+			case LogThreadRole::QUEUE:       { return "queue"; }
+			case LogThreadRole::SINK:        { return "sink"; }
+			case LogThreadRole::MAINTENANCE: { return "maintenance"; }
+			default:                         { return "unknown"; }
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------------
+// Implementation for PlacedThread
+// ---------------------------------------------------------------------------------
+PlacedThread::PlacedThread(const LogThreadRole role, const char* name) :
+	_role(role),
+	_version(0)
+{
+#ifdef __linux__
+	const std::string shortName = std::string(name).substr(0, 15);
+	pthread_setname_np(pthread_self(), shortName.c_str());
+
+	CPU_ZERO(&_initialCpus);
+	pthread_getaffinity_np(pthread_self(), sizeof(_initialCpus), &_initialCpus);
+#endif
+
+	// Nothing's touched until the role has been given a placement.
+	Refresh();
+}
+
+void PlacedThread::Refresh()
+{
+	if (placementVersions[RoleIndex(_role)].load(std::memory_order_acquire) != _version) { Apply(); }
+}
+
+void PlacedThread::Apply()
+{
+	const size_t i = RoleIndex(_role);
+
+	ThreadPlacement placement;
+	{
+		std::lock_guard<std::mutex> lock(placementLock);
+		placement = placements[i];
+		_version = placementVersions[i].load(std::memory_order_relaxed);
+	}
+
+#ifdef __linux__
+	std::ostringstream failures;
+
+	cpu_set_t cpus;
+	CPU_ZERO(&cpus);
+	if (placement._cpus.empty()) { cpus = _initialCpus; }
+	for (const unsigned cpu : placement._cpus) { CPU_SET(cpu, &cpus); }
+
+	int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+	if (err != 0) { failures << " cores (" << std::strerror(err) << ")"; }
+
+	if (placement._policy != LOG_THREAD_KEEP)
+	{
+		sched_param param;
+		std::memset(&param, 0, sizeof(param));
+		param.sched_priority = placement._priority;
+
+		err = pthread_setschedparam(pthread_self(), placement._policy, &param);
+		if (err != 0) { failures << " policy (" << std::strerror(err) << ")"; }
+	}
+
+	// Under Linux, nice values belong to threads rather than processes.
+	if (placement._nice != LOG_THREAD_KEEP)
+	{
+		const id_t tid = static_cast<id_t>(syscall(SYS_gettid));
+		if (setpriority(PRIO_PROCESS, tid, placement._nice) != 0) { failures << " nice (" << std::strerror(errno) << ")"; }
+	}
+
+	if (!failures.str().empty() && warnedVersions[i].exchange(_version) != _version)
+	{
+		std::cerr << "WARNING - Unable to place the logging " << RoleName(_role) << " threads:" << failures.str() << std::endl;
+	}
+#endif
+}
+
+namespace Logging
+{
+	bool SetThreadPlacement(const LogThreadRole role, const ThreadPlacement& placement)
+	{
+#ifndef __linux__
+		std::cerr << "WARNING - Placing the logging threads is only supported under Linux." << std::endl;
+		return false;
+#else
+		const long numCpus = sysconf(_SC_NPROCESSORS_CONF);
+		for (const unsigned cpu : placement._cpus)
+		{
+			if (cpu >= CPU_SETSIZE || static_cast<long>(cpu) >= numCpus)
+			{
+				std::cerr << "ERROR - Unable to place the logging " << RoleName(role) << " threads on core " << cpu << ", as there are only " << numCpus << " cores!" << std::endl;
+				return false;
+			}
+		}
+
+		if (placement._policy != LOG_THREAD_KEEP)
+		{
+			const int lowest = sched_get_priority_min(placement._policy);
+			const int highest = sched_get_priority_max(placement._policy);
+			if (lowest < 0 || highest < 0 || placement._priority < lowest || placement._priority > highest)
+			{
+				std::cerr << "ERROR - Scheduling policy " << placement._policy << " doesn't exist or doesn't take priority " << placement._priority << "!" << std::endl;
+				return false;
+			}
+		}
+
+		std::lock_guard<std::mutex> lock(placementLock);
+		placements[RoleIndex(role)] = placement;
+		placementVersions[RoleIndex(role)].fetch_add(1, std::memory_order_release);
+		return true;
+#endif
+	}
+}
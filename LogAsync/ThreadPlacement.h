@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <vector>
+
+#ifndef _MSC_VER
+#include <sched.h>
+#endif
+
+// Leaves a thread's nice value or scheduling policy as it was.
+constexpr int LOG_THREAD_KEEP = INT_MIN;
+
+// ------------------------------------------------------------------------------------
+// The threads the library starts, grouped by what they do.  Placement is set per role.
+// ------------------------------------------------------------------------------------
+enum class LogThreadRole
+{
+	QUEUE,       // The logging thread that empties the queue, and the shared memory collector.
+	SINK,        // The threads writing to logs and sockets (see Logging::SetSinkThreads).
+	MAINTENANCE  // Threads that mostly sleep: rotation of logs at a time or interval.
+};
+
+constexpr size_t LOG_THREAD_ROLES = 3;
+
+// ------------------------------------------------------------------------------------
+// Where and how the threads of a role run.
+//
+// _cpus is the set of cores they may run on; empty means wherever the process may.
+// _policy is a SCHED_* policy from <sched.h> with _priority as its priority (SCHED_FIFO and
+// SCHED_RR take 1 to 99, and need CAP_SYS_NICE or an RLIMIT_RTPRIO allowance).  _nice only
+// means anything under SCHED_OTHER and SCHED_BATCH; raising it needs no privileges.
+// ------------------------------------------------------------------------------------
+struct ThreadPlacement
+{
+	std::vector<unsigned> _cpus;
+	int _nice = LOG_THREAD_KEEP;
+	int _policy = LOG_THREAD_KEEP;
+	int _priority = 0;
+};
+
+// ------------------------------------------------------------------------------------
+// For the library: each of its threads makes one of these as it starts, which names it
+// and places it as its role says.  Refresh is cheap enough to call every time around the
+// thread's loop, and places the thread again if its role was changed since.
+// ------------------------------------------------------------------------------------
+class PlacedThread
+{
+private:
+	const LogThreadRole _role;
+	uint32_t _version;
+
+#ifdef __linux__
+	cpu_set_t _initialCpus; // Restored if the role stops asking for particular cores.
+#endif
+
+	void Apply();
+
+public:
+	// name is cut to 15 characters, the most a Linux thread name can be.
+	PlacedThread(const LogThreadRole role, const char* name);
+
+	PlacedThread(const PlacedThread&) = delete;
+	PlacedThread& operator=(const PlacedThread&) = delete;
+
+	void Refresh();
+};
+
+namespace Logging
+{
+	// --------------------------------------------------------------------------------------------
+	// Where the library's threads run, so that they stay off cores kept for other work: the logging
+	// thread spins for a while each time it runs out of records (see IdleBackoff), and would
+	// otherwise take time from whatever shares its core.  Threads are also named after their role
+	// ("logasync-queue", "logasync-sink", ...), so they can be told apart in top or a debugger.
+	//
+	// Threads already running move at their next pass through their loop (the logging thread within
+	// LOG_IDLE_PARK_TIMEOUT even when idle; the others when they next have something to do), and
+	// threads started later are placed as they start, so it may be called before or after
+	// InitLogging.  A role set back to a default ThreadPlacement gets back the cores its threads
+	// started with, but nice values and policies are left as they were last set.
+	//
+	// Returns false (with a message to cerr) if a core doesn't exist, the policy doesn't take the
+	// priority, or on platforms other than Linux.  Cores the process may not run on and policies or
+	// nice values it isn't allowed are only found out by the threads applying them, which say so on
+	// cerr and carry on as they were.
+	// --------------------------------------------------------------------------------------------
+	bool SetThreadPlacement(const LogThreadRole role, const ThreadPlacement& placement);
+}
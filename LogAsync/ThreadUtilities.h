@@ -1,45 +1,159 @@
-#pragma once
-
-#include <thread>
-#include <mutex>
-
-#include "TimeManip.h"
-
-// A sleep that will terminate early if a condition is set.  Prevents sleeping threads from being impossible to
-// reach or quit early if we need to globally terminate the application.
-template< class Clock, class Duration, class T>
-inline void InterruptedSleepUntil(const std::chrono::time_point<Clock, Duration>& tp, const T& terminateEarly)
-{
-	while (!terminateEarly && tp - Clock::now() > seconds(1)) { std::this_thread::sleep_for(milliseconds(512)); }
-    if (!terminateEarly) { std::this_thread::sleep_until(tp); }
-}
-
-// A sleep that will terminate early if a condition is set.  Prevents sleeping threads from being impossible to
-// reach or quit early if we need to globally terminate the application.
-template<class TimeUnit, class T>
-inline void InterruptedSleepFor(const TimeUnit t, const T& terminateEarly)
-{
-    InterruptedSleepUntil(steady_clock::now() + t, terminateEarly);
-}
-
-class ThreadRAII
-{
-private:
-    volatile bool _killReq;
-    std::thread _managed;
-
-public:
-
-    template <class ...Args>
-    ThreadRAII(Args&& ...args) :
-        _killReq(false),
-        _managed(std::forward<Args>(args)..., std::ref(_killReq))
-    {}
-
-    ~ThreadRAII()
-    {
-        _killReq = true;
-        if (_managed.joinable()) { _managed.join(); }
-    }
-};
-
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#define LOG_CPU_RELAX() _mm_pause()
+#else
+#define LOG_CPU_RELAX() ((void)0)
+#endif
+
+#include "TimeManip.h"
+
+// Used to keep data written by different threads on separate cache lines.
+constexpr size_t LOG_CACHE_LINE_SIZE = 64;
+
+// A sleep that will terminate early if a condition is set.  Prevents sleeping threads from being impossible to
+// reach or quit early if we need to globally terminate the application.
+template< class Clock, class Duration, class T>
+inline void InterruptedSleepUntil(const std::chrono::time_point<Clock, Duration>& tp, const T& terminateEarly)
+{
+	while (!terminateEarly && tp - Clock::now() > seconds(1)) { std::this_thread::sleep_for(milliseconds(512)); }
+    if (!terminateEarly) { std::this_thread::sleep_until(tp); }
+}
+
+// A sleep that will terminate early if a condition is set.  Prevents sleeping threads from being impossible to
+// reach or quit early if we need to globally terminate the application.
+template<class TimeUnit, class T>
+inline void InterruptedSleepFor(const TimeUnit t, const T& terminateEarly)
+{
+    InterruptedSleepUntil(steady_clock::now() + t, terminateEarly);
+}
+
+class ThreadRAII
+{
+private:
+    volatile bool _killReq;
+    std::thread _managed;
+
+public:
+
+    template <class ...Args>
+    ThreadRAII(Args&& ...args) :
+        _killReq(false),
+        _managed(std::forward<Args>(args)..., std::ref(_killReq))
+    {}
+
+    ~ThreadRAII()
+    {
+        _killReq = true;
+        if (_managed.joinable()) { _managed.join(); }
+    }
+};
+
+// ------------------------------------------------------------------------------------------------------
+// An event count: a way for one thread to sleep until others say there's something for it to do,
+// without them paying for a lock or a system call when it isn't sleeping.
+//
+// The waiting thread announces itself with PrepareWait, checks its condition once more, and then
+// either calls CancelWait or Wait.  Notifying threads only touch the mutex if somebody announced
+// themselves, so notifying costs a single load while the waiter is busy.
+//
+// Notify must come after the data the waiter checks for has been published.  Both sides fence between
+// publishing and looking at what the other published, so that either the waiter sees the data or Notify
+// sees the waiter; the data itself only needs a release store.
+// ------------------------------------------------------------------------------------------------------
+class EventCount
+{
+private:
+	std::atomic<uint32_t> _waiters;
+	std::atomic<uint32_t> _epoch;
+	std::mutex _lock;
+	std::condition_variable _wakeup;
+
+public:
+	EventCount() : _waiters(0), _epoch(0), _lock(), _wakeup() {}
+
+	uint32_t PrepareWait()
+	{
+		_waiters.fetch_add(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return _epoch.load(std::memory_order_acquire);
+	}
+
+	void CancelWait()
+	{
+		_waiters.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	// Sleeps until Notify is called after PrepareWait returned key, or until the timeout passes.
+	template <class TimeUnit>
+	void Wait(const uint32_t key, const TimeUnit timeout)
+	{
+		{
+			std::unique_lock<std::mutex> lock(_lock);
+			_wakeup.wait_for(lock, timeout, [this, key] { return _epoch.load(std::memory_order_relaxed) != key; });
+		}
+		_waiters.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void Notify()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (_waiters.load(std::memory_order_relaxed) == 0) { return; }
+
+		{
+			std::lock_guard<std::mutex> lock(_lock);
+			_epoch.fetch_add(1, std::memory_order_release);
+		}
+		_wakeup.notify_all();
+	}
+};
+
+// ------------------------------------------------------------------------------------------------------
+// What a thread does each time it finds nothing to do: spin for a little while (work usually shows
+// up again quickly under load), then yield its time slice, and then sleep on an EventCount until it
+// gets notified.  The sleep has a timeout so that the thread still notices when it's told to quit.
+// ------------------------------------------------------------------------------------------------------
+constexpr unsigned LOG_IDLE_SPIN_ROUNDS = 64;     // Rounds spent spinning...
+constexpr unsigned LOG_IDLE_SPIN_PAUSES = 32;     // ...for this many pause instructions each.
+constexpr unsigned LOG_IDLE_YIELD_ROUNDS = 16;    // Rounds spent yielding after that.
+constexpr milliseconds LOG_IDLE_PARK_TIMEOUT(50); // Longest time spent asleep before checking again.
+
+class IdleBackoff
+{
+private:
+	unsigned _rounds;
+
+public:
+	IdleBackoff() : _rounds(0) {}
+
+	// Call whenever there was something to do.
+	void Reset() { _rounds = 0; }
+
+	// ready() is checked once more before sleeping, after announcing the wait.
+	template <class ReadyCheck, class TimeUnit = milliseconds>
+	void Pause(EventCount& e, ReadyCheck ready, const TimeUnit parkTimeout = LOG_IDLE_PARK_TIMEOUT)
+	{
+		if (_rounds < LOG_IDLE_SPIN_ROUNDS)
+		{
+			++_rounds;
+			for (unsigned i = 0; i < LOG_IDLE_SPIN_PAUSES; ++i) { LOG_CPU_RELAX(); }
+		}
+		else if (_rounds < LOG_IDLE_SPIN_ROUNDS + LOG_IDLE_YIELD_ROUNDS)
+		{
+			++_rounds;
+			std::this_thread::yield();
+		}
+		else
+		{
+			const uint32_t key = e.PrepareWait();
+			if (ready()) { e.CancelWait(); }
+			else { e.Wait(key, parkTimeout); }
+		}
+	}
+};
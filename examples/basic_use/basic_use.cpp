@@ -1,64 +1,131 @@
-#include <vector>
-#include <future>
-
-#include "LogAsync.h"
-
-int main(int argc, char* argv[])
-{
-    auto logfile = Logging::RegisterLog("LogAsync_Basics.txt");
-
-    // 1) We have basic logging of strings and tags.  Tags can, but do not need to include logging levels.
-    
-    LOG_ASYNC("Testing") << "I have " << 4 << " cars and " << 1.0/3.0 << " gallons of gas remaining!" << std::endl;
-    LOG_ASYNC_C({"Testing"}, "I have %d cars and %.4f gallons of gas remaining!", 15, 1.0 / 3.0);
-
-    // 2) We can conditionally log statements based on expressions.
-
-    volatile bool truthBeTold = true;
-
-    LOG_ASYNC_IF(truthBeTold == true, "Testing") << "The truth was told." << std::endl;      // This should show up
-    LOG_ASYNC_IF_C(truthBeTold == true, {"Testing"}, "The truth was told");                  // This should show up too
-    
-    LOG_ASYNC_IF(truthBeTold == false, "Testing") << "The truth was not told." << std::endl; // This should not
-    LOG_ASYNC_IF_C(truthBeTold == false, {"Testing"}, "The truth was not told.");            // This shouldn't either.
-
-    // 3) We can log every N instances of something we want to track. ----------------------------------
-
-    for (unsigned i = 0; i < 20; ++i)
-    {
-        LOG_ASYNC_EVERY(5, "Testing") << "Logging with i=" << i << std::endl;
-        LOG_ASYNC_EVERY_C(5, {"Testing"}, "Printf-style Logging with i=%d", i);
-    }
-
-
-    // 4) We can log every N instances of an identified term.  If you have multiple threads running the
-    //    same code, then you can pass a thread id or unique integer to the ID field of LOG_ASYNC_EVERY_ID
-    //    so that it keeps track of every n logs per thread you're running.
-    
-    std::vector<std::future<void>> massiveAsync;
-
-    for (unsigned i = 0; i < 100; ++i)
-    {
-        massiveAsync.emplace_back(
-            std::async(
-                std::launch::async,
-                [](const int id)
-                  {
-                    for (volatile unsigned j = 0; j < 100; ++j)
-                    {
-                        // Even in tests like this, some of the numbers might not show up entirely accurately,
-                        // though most of them should - depending on how a compiler decides to optimize the loops
-                        // below, and how mutex access takes hold, there may be one or two numbers off...
-                        LOG_ASYNC_EVERY_ID(id, 10, "Testing") << "Logging from ID " << id << " with j=" << j << std::endl;
-                        LOG_ASYNC_EVERY_ID_C(id, 10, {"Testing"}, "Logging C from ID %d with j=%d", id, j);
-                    }
-                },
-                i));
-    }
-
-    for (auto& elem : massiveAsync) { elem.get(); }
-    
-    Logging::ShutdownLogging();
-    
-    return 0;
+#include <vector>
+#include <future>
+
+#include "LogAsync.h"
+
+int main(int argc, char* argv[])
+{
+    auto logfile = Logging::RegisterLog("LogAsync_Basics.txt");
+
+    // Logs start getting records as soon as they're registered, so configure them before logging
+    // anything they shouldn't see.  These two are used by sections 8 and 9.
+
+    auto slowRequests = Logging::RegisterLog("LogAsync_SlowRequests.txt");
+    slowRequests->SetFieldFormat(FieldFormat::JSON);
+    slowRequests->DisableCache(); // The filter looks at values, which change from record to record.
+    slowRequests->AddInputFilter([](const LogData& l)
+    {
+        FieldValue latency;
+        return l.FindField("latency_us", latency) && latency.AsDouble() > 10000;
+    });
+
+    auto requests = Logging::RegisterLog("LogAsync_Requests.txt");
+    requests->SetConfiguration("%t | %S | %C | %m", DEFAULT_TIME);
+    requests->SetFieldFormat(FieldFormat::LOGFMT);
+    requests->AddInputFilter([](const LogData& l) { return l._site->_tags.Contains("Requests"); });
+
+    // 1) We have basic logging of strings and tags.  Tags can, but do not need to include logging levels.
+    
+    LOG_ASYNC("Testing") << "I have " << 4 << " cars and " << 1.0/3.0 << " gallons of gas remaining!" << std::endl;
+    LOG_ASYNC_C({"Testing"}, "I have %d cars and %.4f gallons of gas remaining!", 15, 1.0 / 3.0);
+
+    // 2) We can conditionally log statements based on expressions.
+
+    volatile bool truthBeTold = true;
+
+    LOG_ASYNC_IF(truthBeTold == true, "Testing") << "The truth was told." << std::endl;      // This should show up
+    LOG_ASYNC_IF_C(truthBeTold == true, {"Testing"}, "The truth was told");                  // This should show up too
+    
+    LOG_ASYNC_IF(truthBeTold == false, "Testing") << "The truth was not told." << std::endl; // This should not
+    LOG_ASYNC_IF_C(truthBeTold == false, {"Testing"}, "The truth was not told.");            // This shouldn't either.
+
+    // 3) We can log every N instances of something we want to track. ----------------------------------
+
+    for (unsigned i = 0; i < 20; ++i)
+    {
+        LOG_ASYNC_EVERY(5, "Testing") << "Logging with i=" << i << std::endl;
+        LOG_ASYNC_EVERY_C(5, {"Testing"}, "Printf-style Logging with i=%d", i);
+    }
+
+
+    // 4) We can log every N instances of an identified term.  The count is kept per line and per ID, so
+    //    the ID can be a thread id, a user id, a connection, or anything else you want to throttle
+    //    separately - each one gets logged every n times, wherever it's logged from.
+    
+    std::vector<std::future<void>> massiveAsync;
+
+    for (unsigned i = 0; i < 100; ++i)
+    {
+        massiveAsync.emplace_back(
+            std::async(
+                std::launch::async,
+                [](const int id)
+                  {
+                    for (volatile unsigned j = 0; j < 100; ++j)
+                    {
+                        LOG_ASYNC_EVERY_ID(id, 10, "Testing") << "Logging from ID " << id << " with j=" << j << std::endl;
+                        LOG_ASYNC_EVERY_ID_C(id, 10, {"Testing"}, "Logging C from ID %d with j=%d", id, j);
+                    }
+                },
+                i));
+    }
+
+    for (auto& elem : massiveAsync) { elem.get(); }
+
+    // 5) Formatting can be left to the logging thread.  The calling thread only copies the raw arguments,
+    //    and the logged text is the same as it would have been otherwise.  Printf style format strings
+    //    must be string literals when formatting is deferred.
+
+    Logging::SetFormattingMode(Logging::FormattingMode::DEFERRED);
+
+    LOG_ASYNC("Testing") << "Deferred: I have " << 4 << " cars and " << 1.0/3.0 << " gallons of gas remaining!" << std::endl;
+    LOG_ASYNC_C({"Testing"}, "Deferred: I have %d cars and %.4f gallons of gas remaining!", 15, 1.0 / 3.0);
+
+    Logging::SetFormattingMode(Logging::FormattingMode::IMMEDIATE);
+
+    // 6) We can cap how often a line is logged in time, rather than in number of hits.  This logs at
+    //    most 10 lines a second (in bursts of up to 5), and says how many were skipped in between.
+
+    const auto rateStart = std::chrono::steady_clock::now();
+    for (unsigned i = 0; std::chrono::steady_clock::now() - rateStart < std::chrono::milliseconds(500); ++i)
+    {
+        LOG_ASYNC_RATE(10, 5, "Testing") << "Rate limited logging with i=" << i << std::endl;
+    }
+
+    // 7) A log can collapse a line that keeps repeating itself.  Identical records from the same line
+    //    within the window are counted rather than written, and show up as "last message repeated N times".
+
+    logfile->EnableCoalescing(std::chrono::milliseconds(100));
+    for (unsigned i = 0; i < 1000; ++i)
+    {
+        LOG_ASYNC("Testing") << "The same thing went wrong again" << std::endl;
+    }
+    LOG_ASYNC("Testing") << "Something else happened" << std::endl;
+
+    // 8) Records can be typed key/value fields rather than text.  Numbers aren't converted to text by the
+    //    logging call, each log picks how the fields are written (text, logfmt or JSON), and filters can
+    //    check values directly - LogAsync_SlowRequests.txt (set up at the top) only takes the slow ones.
+
+    const std::string user = "jane doe";
+    LOG_ASYNC_KV("Testing")("latency_us", 1250)("user", user)("cache_hit", false)("load", 0.75);
+    LOG_ASYNC_KV("Testing")("latency_us", 15000)("user", user)("cache_hit", true)("load", 0.9);
+
+    // 9) Fields that every line logged by a thread should carry (a request id, a tenant) can be put in a
+    //    scoped context rather than repeated on each line.  Lines share the context instead of copying
+    //    it, and %C writes it out (see LogAsync_Requests.txt, set up at the top).
+
+    {
+        Logging::ScopedContext request("request_id", 7731, "tenant", "acme");
+        LOG_ASYNC("Testing", "Requests") << "Request received" << std::endl;
+        {
+            Logging::ScopedContext step("step", "authorize");
+            LOG_ASYNC("Testing", "Requests") << "Checking permissions" << std::endl;
+        }
+        LOG_ASYNC("Testing", "Requests") << "Request finished" << std::endl;
+    }
+    LOG_ASYNC("Testing", "Requests") << "Outside of any request" << std::endl;
+    
+    Logging::ShutdownLogging();
+    
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,47 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "LogAsync.h"
+
+// Logs a burst of records from a few threads and then crashes, to show what the crash handler
+// saves.  LogAsync_Crash.txt ends with a crash marker, and whatever was still waiting in the
+// rings is in LogAsync_Crash.queued.txt.
+//
+// Usage: crash_handler [abort|segv]
+int main(int argc, char* argv[])
+{
+	const bool segfault = argc > 1 && std::strcmp(argv[1], "segv") == 0;
+
+	Logging::InitLogging(Logging::InitializationMode::ALLOW_UNORDERED, Logging::QueueEngine::PER_THREAD_RINGS);
+	auto logfile = Logging::RegisterLog("LogAsync_Crash.txt");
+
+	// Opt in.  Records that never reached a log go to their own file, as they haven't been
+	// through the log's filters or formatting.
+	if (!Logging::EnableCrashHandler("LogAsync_Crash.queued.txt"))
+	{
+		std::cerr << "The crash handler isn't available here." << std::endl;
+		return 1;
+	}
+
+	std::vector<std::thread> threads;
+	for (unsigned t = 0; t < 4; ++t)
+	{
+		threads.emplace_back([t]()
+		{
+			for (unsigned i = 0; i < 2000; ++i) { LOG_ASYNC("Burst", LOG_INFO) << "Thread " << t << " record " << i << std::endl; }
+		});
+	}
+	for (auto& t : threads) { t.join(); }
+
+	LOG_ASYNC("Crash", LOG_FATAL) << "About to crash; this is the last thing logged." << std::endl;
+
+	if (segfault)
+	{
+		volatile int* nowhere = nullptr;
+		*nowhere = 1;
+	}
+	std::abort();
+}
@@ -0,0 +1,93 @@
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "LogAsync.h"
+
+// Several worker processes logging through one collector process, which owns the only log file.
+// Each worker forks a child after attaching, and both log from a few threads.  Records only go
+// missing if the collector can't keep up, in which case LogAsync_Shared.txt says how many were
+// dropped and where.
+//
+// Usage: shared_queue [number of workers] [records per thread]
+int main(int argc, char* argv[])
+{
+	const unsigned numWorkers = argc > 1 ? std::stoul(argv[1]) : 4;
+	const unsigned numRecords = argc > 2 ? std::stoul(argv[2]) : 20000;
+	const unsigned numThreads = 2;
+	const std::string queueName = "/LogAsync_shared_example";
+
+	// Workers are forked before the collector starts any threads, and wait on the pipe until the
+	// queue exists.
+	int ready[2];
+	if (pipe(ready) != 0) { return 1; }
+
+	std::vector<pid_t> workers;
+	for (unsigned w = 0; w < numWorkers; ++w)
+	{
+		const pid_t pid = fork();
+		if (pid != 0)
+		{
+			workers.push_back(pid);
+			continue;
+		}
+
+		char go;
+		close(ready[1]);
+		if (read(ready[0], &go, 1) != 1 || !Logging::AttachToSharedQueue(queueName)) { _exit(1); }
+
+		// Forking after attaching: the child gets a lane of its own.
+		const bool isChild = fork() == 0;
+
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < numThreads; ++t)
+		{
+			threads.emplace_back([=]()
+			{
+				// Context fields and structured fields travel with the records.
+				Logging::ScopedContext context("pid", getpid(), "thread", t);
+				for (unsigned i = 0; i < numRecords; ++i)
+				{
+					LOG_ASYNC("Worker", LOG_INFO) << "record " << i << std::endl;
+					if (i % 1024 == 0) { std::this_thread::sleep_for(milliseconds(1)); }
+				}
+			});
+		}
+		for (auto& t : threads) { t.join(); }
+		LOG_ASYNC_KV("Worker", LOG_INFO)("pid", getpid())("forked", isChild)("records", numRecords * numThreads);
+
+		if (!isChild) { wait(nullptr); }
+		_exit(0);
+	}
+	close(ready[0]);
+
+	Logging::InitLogging(Logging::InitializationMode::ALLOW_UNORDERED);
+	auto logfile = Logging::RegisterLog("LogAsync_Shared.txt");
+	logfile->SetConfiguration("%t | %C | %S | %T | %m");
+
+	const auto start = steady_clock::now();
+	if (!Logging::StartCollector(queueName, 2 * numWorkers)) { return 1; }
+
+	for (unsigned w = 0; w < numWorkers; ++w) { if (write(ready[1], "g", 1) != 1) { return 1; } }
+	for (const pid_t pid : workers) { waitpid(pid, nullptr, 0); }
+
+	Logging::StopCollector();
+	Logging::Flush();
+	const double elapsed = duration<double>(steady_clock::now() - start).count();
+
+	std::ifstream written("LogAsync_Shared.txt");
+	uint64_t numWritten = 0;
+	for (std::string line; std::getline(written, line);) { numWritten += line.find("Worker") != std::string::npos; }
+
+	const uint64_t numLogged = 2ull * numWorkers * (numThreads * numRecords + 1);
+	std::cout << numWritten << " of " << numLogged << " records logged by " << 2 * numWorkers << " processes were written in "
+	          << elapsed << "s (" << numLogged / elapsed << " records/s)" << std::endl;
+
+	Logging::ShutdownLogging();
+	return 0;
+}
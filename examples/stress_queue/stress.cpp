@@ -1,53 +1,114 @@
-#include <future>
-#include <atomic>
-
-#include "LogAsync.h"
-
-int main(int argc, char* argv[])
-{
-	//Logging::InitLogging(Logging::InitializationMode::NO_OP_MODE);
-	Logging::InitLogging(Logging::InitializationMode::NO_OP_ORDERED);
-
-    // We need to register a logging unit, otherwise the system says "Oh! None are present! Let's not log!"
-    auto logfile = Logging::RegisterLog("LogAsync_NoOp.txt");
-
-	std::vector<std::future<void>> futures; // A bunch of threads.
-	std::atomic<bool> quit(false); // Tell the threads to quit
-	std::atomic<int> wait(0); // Wait for all threads to be ready before starting timers...
-
-	const unsigned numThreads = std::max<unsigned>(1, std::thread::hardware_concurrency() - 1);
-	//const unsigned numThreads = 1;
-	for (unsigned i = 0; i < numThreads; ++i)
-	{
-		futures.emplace_back(std::async(std::launch::async, [i, &quit, &wait, numThreads]()
-		{
-			int j = 0;
-			++wait;
-
-			// Wait for all threads to be ready before starting...
-			while (wait != numThreads) { std::this_thread::sleep_for(microseconds(1)); }
-			while (!quit.load(std::memory_order_relaxed))
-			{
-				// This is the only part of the setup that is related to logging.
-				LOG_ASYNC("asdf") << "Thread " << i << " logging " << j++ << std::endl;
-				/*
-				for (unsigned q = 0; q < 8; ++q)
-				{
-					std::this_thread::yield();
-				}
-				*/
-			}
-		}));
-	}
-
-	// Wait for all threads to be ready before starting...
-	while (wait != numThreads) { std::this_thread::sleep_for(microseconds(1)); }
-
-	// Capture three seconds worth of logdata.
-	std::this_thread::sleep_for(seconds(3));
-	quit = true;
-	for (auto& future : futures) { future.get(); }
-	
-	Logging::ShutdownLogging();
-    return 0;
+#include <future>
+#include <atomic>
+#include <string>
+#include <iostream>
+
+#include "LogAsync.h"
+
+// Usage: stress [shared|rings] [ordered|nearly|unordered] [memory limit in KB] [system|coarse|raw|tsc] [threads]
+//               [unpinned|pinned|compare]
+//
+// Compares the shared queue against per-thread rings, with or without ordering ("nearly" orders
+// records within the reorder window).  If a memory
+// limit is given, records that don't fit are dropped rather than letting the queue grow.  The
+// clock argument picks the clock records are timestamped with, and the one after it how many threads
+// log (one less than the number of cores by default).  Running it with more and more threads shows
+// how each mode scales.  "pinned" keeps the logging thread on the last core (see
+// Logging::SetThreadPlacement), and "compare" runs unpinned and then pinned, one after the other.
+ClockSource ParseClockSource(const std::string& s)
+{
+	if (s == "coarse") { return ClockSource::REALTIME_COARSE; }
+	if (s == "raw") { return ClockSource::MONOTONIC_RAW; }
+	if (s == "tsc") { return ClockSource::TSC; }
+	return ClockSource::SYSTEM;
+}
+
+int main(int argc, char* argv[])
+{
+	const bool useRings = argc > 1 && std::string(argv[1]) == "rings";
+	const std::string ordering = argc > 2 ? argv[2] : "ordered";
+	const uint64_t memoryLimitKB = argc > 3 ? std::stoull(argv[3]) : 0;
+	const ClockSource clock = ParseClockSource(argc > 4 ? argv[4] : "system");
+	const unsigned numThreads = argc > 5 ? std::max(1, std::stoi(argv[5])) : std::max<unsigned>(1, std::thread::hardware_concurrency() - 1);
+	const std::string placement = argc > 6 ? argv[6] : "unpinned";
+
+	if (memoryLimitKB > 0)
+	{
+		std::cout << "Queue memory limited to " << memoryLimitKB << "KB, dropping the newest records past that." << std::endl;
+		Logging::SetQueueMemoryLimit(TO_KILOBYTES(memoryLimitKB), Logging::OverflowPolicy::DROP_NEWEST);
+	}
+
+	std::cout << "Queue engine: " << (useRings ? "per-thread rings" : "shared queue") << ", " << ordering << std::endl;
+	Logging::InitLogging(ordering == "unordered" ? Logging::InitializationMode::NO_OP_MODE :
+						 ordering == "nearly" ? Logging::InitializationMode::NO_OP_NEARLY_ORDERED :
+												Logging::InitializationMode::NO_OP_ORDERED,
+						 useRings ? Logging::QueueEngine::PER_THREAD_RINGS : Logging::QueueEngine::SHARED_QUEUE,
+						 clock);
+	std::cout << "Clock source: " << ClockSourceName(Logging::ActiveClockSource()) << std::endl;
+
+    // We need to register a logging unit, otherwise the system says "Oh! None are present! Let's not log!"
+    auto logfile = Logging::RegisterLog("LogAsync_NoOp.txt");
+
+	// Logs from numThreads threads for a few seconds, returning how many records they logged.
+	auto runPhase = [numThreads](const char* name)
+	{
+		std::vector<std::future<uint64_t>> futures; // A bunch of threads, returning how many records they logged.
+		std::atomic<bool> quit(false); // Tell the threads to quit
+		std::atomic<unsigned> wait(0); // Wait for all threads to be ready before starting timers...
+
+		for (unsigned i = 0; i < numThreads; ++i)
+		{
+			futures.emplace_back(std::async(std::launch::async, [i, &quit, &wait, numThreads]()
+			{
+				uint64_t j = 0;
+				++wait;
+
+				// Wait for all threads to be ready before starting...
+				while (wait != numThreads) { std::this_thread::sleep_for(microseconds(1)); }
+				while (!quit.load(std::memory_order_relaxed))
+				{
+					// This is the only part of the setup that is related to logging.
+					LOG_ASYNC("asdf") << "Thread " << i << " logging " << j++ << std::endl;
+				}
+				return j;
+			}));
+		}
+
+		// Wait for all threads to be ready before starting...
+		while (wait != numThreads) { std::this_thread::sleep_for(microseconds(1)); }
+
+		// Capture three seconds worth of logdata.
+		std::this_thread::sleep_for(seconds(3));
+		quit = true;
+		uint64_t numLogged = 0;
+		for (auto& future : futures) { numLogged += future.get(); }
+		std::cout << name << ": " << numThreads << " threads logged " << numLogged << " records (" << numLogged / 3 << " per second)" << std::endl;
+		return numLogged;
+	};
+
+	// Pinning keeps the logging thread on the last core, out of the way of the threads logging.
+	auto pin = []()
+	{
+		ThreadPlacement placement;
+		placement._cpus = {std::max(1u, std::thread::hardware_concurrency()) - 1};
+		return Logging::SetThreadPlacement(LogThreadRole::QUEUE, placement) && Logging::SetThreadPlacement(LogThreadRole::SINK, placement);
+	};
+
+	if (placement == "compare")
+	{
+		const uint64_t unpinned = runPhase("Unpinned");
+		if (!pin()) { return 1; }
+		const uint64_t pinned = runPhase("Pinned");
+		std::cout << "Pinning the logging thread changed throughput by " << (100.0 * pinned / std::max<uint64_t>(1, unpinned) - 100.0) << "%" << std::endl;
+	}
+	else if (placement == "pinned")
+	{
+		if (!pin()) { return 1; }
+		runPhase("Pinned");
+	}
+	else { runPhase("Unpinned"); }
+
+	Logging::ShutdownLogging();
+	if (memoryLimitKB > 0) { std::cout << "Dropped " << Logging::NumDroppedMessages() << " messages" << std::endl; }
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#include <ctime>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+#include "LogAsync.h"
+
+// Measures what the logging thread's idle handling costs: how long it takes for the first record
+// after a quiet period to reach a log, and how much CPU the process burns while nothing is logged.
+//
+// Usage: wakeup_latency [number of samples] [idle time between samples in ms]
+int main(int argc, char* argv[])
+{
+	const unsigned numSamples = argc > 1 ? std::stoul(argv[1]) : 200;
+	const milliseconds quietPeriod(argc > 2 ? std::stoul(argv[2]) : 5);
+
+	Logging::InitLogging(Logging::InitializationMode::ALLOW_UNORDERED);
+
+	// The filter runs on the logging side, so it sees each record the moment a log gets it.
+	std::mutex latencyLock;
+	std::vector<int64_t> latencies;
+
+	auto logfile = Logging::RegisterLog("LogAsync_Wakeup.txt");
+	logfile->DisableCache();
+	logfile->AddInputFilter([&](const LogData& l)
+	{
+		FieldValue sent;
+		if (!l.FindField("sent_ns", sent)) { return false; }
+
+		const int64_t now = duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+		std::lock_guard<std::mutex> lock(latencyLock);
+		latencies.push_back(now - sent._signed);
+		return true;
+	});
+
+	for (unsigned i = 0; i < numSamples; ++i)
+	{
+		std::this_thread::sleep_for(quietPeriod);
+		LOG_ASYNC_KV("Wakeup")("sent_ns", duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count())("sample", i);
+	}
+	std::this_thread::sleep_for(milliseconds(100));
+
+	{
+		std::lock_guard<std::mutex> lock(latencyLock);
+		std::sort(latencies.begin(), latencies.end());
+		if (!latencies.empty())
+		{
+			auto percentile = [&](const double p) { return latencies[static_cast<size_t>(p * (latencies.size() - 1))] / 1000.0; };
+			std::cout << "Wake to write latency over " << latencies.size() << " samples (us): "
+			          << "median " << percentile(0.5) << ", 99th " << percentile(0.99) << ", max " << percentile(1.0) << std::endl;
+		}
+	}
+
+	// Nothing is logged from here on, so any CPU time used is the cost of waiting.
+	const std::clock_t cpuStart = std::clock();
+	const auto wallStart = steady_clock::now();
+	std::this_thread::sleep_for(seconds(2));
+	const double cpuMs = 1000.0 * (std::clock() - cpuStart) / CLOCKS_PER_SEC;
+	const double wallMs = duration<double, std::milli>(steady_clock::now() - wallStart).count();
+
+	std::cout << "CPU used while idle: " << cpuMs << "ms over " << wallMs << "ms" << std::endl;
+
+	Logging::ShutdownLogging();
+	return 0;
+}